@@ -0,0 +1,206 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Player/DropletCharacterMovementComponent.h"
+
+#include "Player/DropletPlayerCharacter.h"
+#include "Framework/VeinLogCategories.h"
+
+
+void UDropletCharacterMovementComponent::StartSplash()
+{
+	m_fSplashAccumulatedTime = 0.f;
+	SetMovementMode(MOVE_Custom, static_cast<uint8>(EDropletCustomMovementMode::EDropletCustomMovementMode_Splash));
+}
+
+void UDropletCharacterMovementComponent::StartSlideDash()
+{
+	m_fSlideDashAccumulatedTime = 0.f;
+}
+
+bool UDropletCharacterMovementComponent::IsInSplashMode() const
+{
+	return MovementMode == MOVE_Custom && CustomMovementMode == static_cast<uint8>(EDropletCustomMovementMode::EDropletCustomMovementMode_Splash);
+}
+
+void UDropletCharacterMovementComponent::PhysCustom(float fDeltaTime, int32 iIterations)
+{
+	//Switch on the custom movement mode
+	switch (static_cast<EDropletCustomMovementMode>(CustomMovementMode))
+	{
+	case EDropletCustomMovementMode::EDropletCustomMovementMode_Splash:
+		PhysSplash(fDeltaTime, iIterations);
+		break;
+	default:
+		Super::PhysCustom(fDeltaTime, iIterations);
+		break;
+	}
+}
+
+void UDropletCharacterMovementComponent::PhysSplash(float fDeltaTime, int32 iIterations)
+{
+	if (fDeltaTime < MIN_TICK_TIME)
+	{
+		return;
+	}
+
+	ADropletPlayerCharacter* pCharacter = GetDropletCharacter();
+	float fRemainingTime = fDeltaTime;
+
+	// Simulate the splash in sub steps, like the falling physics, so long frames are split the same way
+	while (fRemainingTime >= MIN_TICK_TIME && iIterations < MaxSimulationIterations)
+	{
+		iIterations++;
+		const float fTimeTick = GetSimulationTimeStep(fRemainingTime, iIterations);
+		FVector vSplashVelocity = FVector::ZeroVector;
+
+		//If the splash is over, go back to the ground or fall for the remaining time
+		if (pCharacter == nullptr || !EvaluateVelocityRule(fTimeTick,
+			[pCharacter](float fStepTime, FVector& vOutVelocity) { return pCharacter->ComputeSplashVelocity(fStepTime, vOutVelocity); },
+			m_fSplashAccumulatedTime, vSplashVelocity))
+		{
+			FindFloor(UpdatedComponent->GetComponentLocation(), CurrentFloor, false);
+			SetMovementMode(CurrentFloor.IsWalkableFloor() ? GetGroundMovementMode() : MOVE_Falling);
+			StartNewPhysics(fRemainingTime, iIterations);
+			return;
+		}
+
+		fRemainingTime -= fTimeTick;
+		bJustTeleported = false;
+
+		// The splash rule drives the velocity, no acceleration, friction or gravity is applied
+		Velocity = vSplashVelocity;
+
+		const FVector vDelta = Velocity * fTimeTick;
+		FHitResult hit(1.f);
+		SafeMoveUpdatedComponent(vDelta, UpdatedComponent->GetComponentQuat(), true, hit);
+
+		//If we hit something, slide along it
+		if (hit.Time < 1.f)
+		{
+			HandleImpact(hit, fTimeTick, vDelta);
+			SlideAlongSurface(vDelta, 1.f - hit.Time, hit.Normal, hit, true);
+		}
+
+		//If the impact changed the movement mode, continue the remaining time in the new one
+		if (!IsInSplashMode())
+		{
+			StartNewPhysics(fRemainingTime, iIterations);
+			return;
+		}
+	}
+}
+
+void UDropletCharacterMovementComponent::CalcVelocity(float fDeltaTime, float fFriction, bool bFluid, float fBrakingDeceleration)
+{
+	ADropletPlayerCharacter* pCharacter = GetDropletCharacter();
+	FVector vSlideDashVelocity = FVector::ZeroVector;
+
+	const FVector vCurrentVelocity = Velocity;
+
+	//If we are slide dashing on the ground, the slide dash rule replaces the acceleration and the friction
+	if (pCharacter != nullptr && IsMovingOnGround() && EvaluateVelocityRule(fDeltaTime,
+		[pCharacter, &vCurrentVelocity](float fStepTime, FVector& vOutVelocity) { return pCharacter->ComputeSlideDashVelocity(fStepTime, vCurrentVelocity, vOutVelocity); },
+		m_fSlideDashAccumulatedTime, vSlideDashVelocity))
+	{
+		Velocity = vSlideDashVelocity;
+		return;
+	}
+
+	Super::CalcVelocity(fDeltaTime, fFriction, bFluid, fBrakingDeceleration);
+}
+
+FVector UDropletCharacterMovementComponent::NewFallVelocity(const FVector& vInitialVelocity, const FVector& vGravity, float fDeltaTime) const
+{
+	FVector vFallVelocity = Super::NewFallVelocity(vInitialVelocity, vGravity, fDeltaTime);
+
+	//If the character is falling faster than the max falling speed, set it back to the max falling speed
+	if (const ADropletPlayerCharacter* pCharacter = GetDropletCharacter())
+	{
+		float fMaxFallSpeed = pCharacter->GetMaxFallSpeed();
+		if (fMaxFallSpeed > 0.f)
+		{
+			vFallVelocity.Z = FMath::Max(vFallVelocity.Z, -fMaxFallSpeed);
+		}
+	}
+
+	return vFallVelocity;
+}
+
+void UDropletCharacterMovementComponent::OnMovementModeChanged(EMovementMode ePreviousMovementMode, uint8 uiPreviousCustomMode)
+{
+	Super::OnMovementModeChanged(ePreviousMovementMode, uiPreviousCustomMode);
+
+	//If we left the splash mode (splash over or movement mode set by a state change), end the splash
+	if (ePreviousMovementMode == MOVE_Custom && uiPreviousCustomMode == static_cast<uint8>(EDropletCustomMovementMode::EDropletCustomMovementMode_Splash) && !IsInSplashMode())
+	{
+		if (ADropletPlayerCharacter* pCharacter = GetDropletCharacter())
+		{
+			pCharacter->EndSplash();
+		}
+	}
+}
+
+bool UDropletCharacterMovementComponent::EvaluateVelocityRule(float fDeltaTime, TFunctionRef<bool(float, FVector&)> rule, float& fAccumulatedTime, FVector& vOutVelocity)
+{
+	//If the fixed step mode is disabled, evaluate the rule over the whole movement step
+	if (!m_bUseFixedStepRules)
+	{
+		return rule(fDeltaTime, vOutVelocity);
+	}
+
+	// Velocity at the current time of the rule, without advancing it
+	FVector vCurrentVelocity;
+
+	//If the rule is over, drop the time accumulated for it
+	if (!rule(0.f, vCurrentVelocity))
+	{
+		fAccumulatedTime = 0.f;
+		return false;
+	}
+
+	const float fFixedStepTime = 1.f / FMath::Max(m_fFixedStepRate, 1.f);
+	fAccumulatedTime += fDeltaTime;
+
+	// Average the velocities of the fixed steps covered by this movement step
+	FVector vVelocitySum = FVector::ZeroVector;
+	int32 iStepCount = 0;
+
+	while (fAccumulatedTime >= fFixedStepTime && iStepCount < m_iMaxFixedStepsPerFrame)
+	{
+		FVector vStepVelocity;
+
+		//If the rule ended, stop stepping
+		if (!rule(fFixedStepTime, vStepVelocity))
+		{
+			fAccumulatedTime = 0.f;
+
+			if (iStepCount == 0)
+			{
+				return false;
+			}
+			break;
+		}
+
+		vVelocitySum += vStepVelocity;
+		fAccumulatedTime -= fFixedStepTime;
+		++iStepCount;
+	}
+
+	//If the cap was reached, drop the time over it rather than catching up on the next frames
+	if (fAccumulatedTime >= fFixedStepTime)
+	{
+		UE_LOG(LogSpeed, Verbose, TEXT("UDropletCharacterMovementComponent::EvaluateVelocityRule: dropped %f seconds over the max fixed steps"), fAccumulatedTime - FMath::Fmod(fAccumulatedTime, fFixedStepTime));
+		fAccumulatedTime = FMath::Fmod(fAccumulatedTime, fFixedStepTime);
+	}
+
+	// While less than a fixed step accumulated, keep the velocity of the current time of the rule
+	vOutVelocity = iStepCount > 0 ? vVelocitySum / iStepCount : vCurrentVelocity;
+
+	return true;
+}
+
+ADropletPlayerCharacter* UDropletCharacterMovementComponent::GetDropletCharacter() const
+{
+	return Cast<ADropletPlayerCharacter>(CharacterOwner);
+}
@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "GameFramework/CharacterMovementComponent.h"
+
+#include "DropletCharacterMovementComponent.generated.h"
+
+
+class ADropletPlayerCharacter;
+
+
+/** Custom movement modes of the droplet, used as the custom mode of MOVE_Custom */
+UENUM(BlueprintType)
+enum class EDropletCustomMovementMode : uint8
+{
+	EDropletCustomMovementMode_None UMETA(Hidden),
+	EDropletCustomMovementMode_Splash UMETA(DisplayName = "Splash"),
+};
+
+
+/**
+ * The DropletCharacterMovementComponent class runs the droplet's velocity rules inside the movement simulation:
+ * the splash as a custom movement mode, the slide dash in the walking velocity and the fall speed clamp in the falling velocity.
+ * The rules themselves are evaluated by the DropletPlayerCharacter, which applies them in its Tick for a movement component of another class.
+ * It can only become the character's movement component once AVeinPlayerCharacter forwards an FObjectInitializer to ACharacter.
+ */
+UCLASS()
+class UDropletCharacterMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	/** Evaluate the splash and slide dash rules in fixed steps so their result doesn't depend on the frame rate */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletCharacterMovement|FixedStep", meta = (DisplayName = "Use Fixed Step Rules"))
+	bool m_bUseFixedStepRules = false;
+	/** Rate of the fixed steps in Hz */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletCharacterMovement|FixedStep", meta = (DisplayName = "Fixed Step Rate", ClampMin = "1", EditCondition = "m_bUseFixedStepRules"))
+	float m_fFixedStepRate = 120.f;
+	/** Max number of fixed steps in one movement step, the time over it is dropped on frame spikes */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletCharacterMovement|FixedStep", meta = (DisplayName = "Max Fixed Steps Per Frame", ClampMin = "1", EditCondition = "m_bUseFixedStepRules"))
+	int32 m_iMaxFixedStepsPerFrame = 8;
+
+	/** Called to switch to the splash movement mode once the character started a splash */
+	void StartSplash();
+
+	/** Called once the character started a slide dash, so its rule starts from a clean fixed step */
+	void StartSlideDash();
+
+	/** Returns true if in the splash movement mode */
+	bool IsInSplashMode() const;
+
+protected:
+	/** Called to simulate the custom movement modes */
+	virtual void PhysCustom(float fDeltaTime, int32 iIterations) override;
+
+	/** Called to compute the velocity of the walking and falling physics, replaced by the slide dash rule while slide dashing */
+	virtual void CalcVelocity(float fDeltaTime, float fFriction, bool bFluid, float fBrakingDeceleration) override;
+
+	/** Called to compute the falling velocity, clamped to the max fall speed of the SpeedComponent */
+	virtual FVector NewFallVelocity(const FVector& vInitialVelocity, const FVector& vGravity, float fDeltaTime) const override;
+
+	/** Called when the movement mode changed */
+	virtual void OnMovementModeChanged(EMovementMode ePreviousMovementMode, uint8 uiPreviousCustomMode) override;
+
+	/** Called to simulate the splash movement mode */
+	void PhysSplash(float fDeltaTime, int32 iIterations);
+
+	/**
+	 * Called to evaluate a velocity rule over a movement step, in fixed steps when the fixed step mode is enabled.
+	 * Returns false once the rule is over.
+	 */
+	bool EvaluateVelocityRule(float fDeltaTime, TFunctionRef<bool(float, FVector&)> rule, float& fAccumulatedTime, FVector& vOutVelocity);
+
+	/** Returns the owning DropletPlayerCharacter */
+	ADropletPlayerCharacter* GetDropletCharacter() const;
+
+private:
+	// Time of the splash rule not simulated by a fixed step yet in seconds
+	float m_fSplashAccumulatedTime = 0.f;
+	// Time of the slide dash rule not simulated by a fixed step yet in seconds
+	float m_fSlideDashAccumulatedTime = 0.f;
+};
@@ -4,19 +4,84 @@
 #include "Player/DropletPlayerCharacter.h"
 
 #include "DropletPlayerController.h"
+#include "Player/DropletCharacterMovementComponent.h"
 #include "Framework/VeinLogCategories.h"
 #include "GameFramework/Character.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "../Plugins/EnhancedInput/Source/EnhancedInput/Public/EnhancedInputComponent.h"
 #include "../Plugins/EnhancedInput/Source/EnhancedInput/Public/EnhancedInputSubsystems.h"
 #include "Components/CapsuleComponent.h"
+#include "Engine/AssetManager.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/StreamableManager.h"
+#include "Materials/MaterialInstanceDynamic.h"
 #include "Components/SphereComponent.h"
 #include "Components/Interactables/InputInteractableActorComponent.h"
+#include "Curves/CurveFloat.h"
 #include "Dialogues/VeinDialogueActorComponent.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeExit.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "HAL/IConsoleManager.h"
+#include "RenderingThread.h"
+
+
+DECLARE_STATS_GROUP(TEXT("Droplet"), STATGROUP_Droplet, STATCAT_Advanced);
+
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("State Transition Game Thread (ms)"), STAT_DropletStateTransitionGameThreadMs, STATGROUP_Droplet);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("State Transition Render Command Span (ms)"), STAT_DropletStateTransitionRenderCommandSpanMs, STATGROUP_Droplet);
+
+DECLARE_CYCLE_STAT(TEXT("Tick"), STAT_DropletTick, STATGROUP_Droplet);
+DECLARE_CYCLE_STAT(TEXT("Tick Grounded"), STAT_DropletTickGrounded, STATGROUP_Droplet);
+DECLARE_CYCLE_STAT(TEXT("Tick Airborne"), STAT_DropletTickAirborne, STATGROUP_Droplet);
+DECLARE_CYCLE_STAT(TEXT("GetSlopeAngle"), STAT_DropletGetSlopeAngle, STATGROUP_Droplet);
+DECLARE_CYCLE_STAT(TEXT("IsAscending"), STAT_DropletIsAscending, STATGROUP_Droplet);
+DECLARE_CYCLE_STAT(TEXT("GetHitLineTracedUnder"), STAT_DropletGetHitLineTracedUnder, STATGROUP_Droplet);
+DECLARE_CYCLE_STAT(TEXT("HandleInteractionButtonDisplay"), STAT_DropletHandleInteractionButtonDisplay, STATGROUP_Droplet);
+DECLARE_CYCLE_STAT(TEXT("Interact"), STAT_DropletInteract, STATGROUP_Droplet);
+DECLARE_CYCLE_STAT(TEXT("SetMaterialState"), STAT_DropletSetMaterialState, STATGROUP_Droplet);
+DECLARE_CYCLE_STAT(TEXT("ChangeInputMappingContext"), STAT_DropletChangeInputMappingContext, STATGROUP_Droplet);
+DECLARE_CYCLE_STAT(TEXT("ChangeSkeletalMeshInstance"), STAT_DropletChangeSkeletalMeshInstance, STATGROUP_Droplet);
+DECLARE_CYCLE_STAT(TEXT("ChangeMeshMaterialInstance"), STAT_DropletChangeMeshMaterialInstance, STATGROUP_Droplet);
+DECLARE_CYCLE_STAT(TEXT("ChangeStaminaComponent"), STAT_DropletChangeStaminaComponent, STATGROUP_Droplet);
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Traces Issued"), STAT_DropletTracesIssued, STATGROUP_Droplet);
+
+DECLARE_MEMORY_STAT(TEXT("Interactable Markers"), STAT_DropletInteractableMarkersMemory, STATGROUP_Droplet);
+DECLARE_MEMORY_STAT(TEXT("Interactable Candidates"), STAT_DropletInteractableCandidatesMemory, STATGROUP_Droplet);
+
+CSV_DEFINE_CATEGORY(Droplet, true);
+
+static TAutoConsoleVariable<int32> CVarDropletCsvStats(
+	TEXT("droplet.CsvStats"),
+	0,
+	TEXT("Record the droplet movement and query metrics of every frame in the Droplet category of CSV profiler captures.\n")
+	TEXT("0: off, 1: on"),
+	ECVF_Default);
+
+// Cycle stat of the stat group and named CPU scope in Insights of a droplet hot path
+#define DROPLET_SCOPE(StatName, TraceName) SCOPE_CYCLE_COUNTER(StatName); TRACE_CPUPROFILER_EVENT_SCOPE_STR(TraceName)
+
+// Per frame cost of a benchmark section while the benchmark records, compiled out of Shipping builds
+#if !UE_BUILD_SHIPPING
+#define DROPLET_BENCHMARK_SCOPE(Section) FDropletCostSampler::FScope benchmarkScope(GetBenchmarkSampler(EDropletBenchmarkSection::Section))
+#else
+#define DROPLET_BENCHMARK_SCOPE(Section)
+#endif
 
 
 void ADropletPlayerCharacter::SetMaterialState(EDropletMaterialState eNewMaterialState, bool bIsPlayerInitiated /* = false */)
 {
+	DROPLET_SCOPE(STAT_DropletSetMaterialState, "Droplet::SetMaterialState");
+	DROPLET_BENCHMARK_SCOPE(EDropletBenchmarkSection_SetMaterialState);
+
+	if (m_pReplayRecorder.IsValid())
+	{
+		m_pReplayRecorder->RecordMaterialState(eNewMaterialState);
+	}
+
 	//If the material state is not none
 	if (eNewMaterialState != EDropletMaterialState::EDropletMaterialState_None)
 	{
@@ -38,14 +103,22 @@ void ADropletPlayerCharacter::SetMaterialState(EDropletMaterialState eNewMateria
 			//Apply CharacterMovementComponent material state description specificities
 			materialStateDescription->ApplyCharacterMovementComponentSpecificities();
 
-			//Bind the move function to the move function in the material state description
+			//Cache the material state description for the native move dispatch
+			m_pCurrentMaterialStateDescription = materialStateDescription;
+
+			//Bind the move function to the move function in the material state description, for the reflected move dispatch
 			m_MoveFunction.BindUFunction(materialStateDescription, FName("MoveFunction"));
 
+			//The native call only runs the same function as the reflected one if the state's class resolves the move function to the base class one
+			const UFunction* pMoveFunction = materialStateDescription->FindFunction(FName("MoveFunction"));
+			m_bIsNativeMoveDispatchSafe = pMoveFunction != nullptr && pMoveFunction->GetOwnerClass() == UDropletMaterialStateDescription::StaticClass();
+
 			ChangeInputMappingContext(eNewMaterialState);
 
-			ChangeSkeletalMeshInstance(eNewMaterialState);
+			// The streamed mesh and material of the new state must be loaded before switching to them
+			EnsureMaterialStateAssetsResident(eNewMaterialState);
 
-			ChangeMeshMaterialInstance(eNewMaterialState);
+			ApplyMaterialStateRenderChanges(eNewMaterialState);
 
 			//Notify the material state change
 			OnMaterialStateChange.Broadcast(eNewMaterialState);
@@ -85,6 +158,15 @@ void ADropletPlayerCharacter::SetMaterialState(EDropletMaterialState eNewMateria
 				AddInteractableMarker<UDrillerInteractableMarker>();
 			}
 
+			// Interactions are not available in gazeous state
+			if (eNewMaterialState == EDropletMaterialState::EDropletMaterialState_Gazeous)
+			{
+				FlushInteractableRegistration();
+			}
+
+			// The ground probe is voted again with the new state's movement
+			InvalidateGroundProbeCache();
+
 			m_bJustChangedState = true;
 
 			//Log the new material state
@@ -97,7 +179,12 @@ void ADropletPlayerCharacter::SetMaterialState(EDropletMaterialState eNewMateria
 		GetCharacterMovement()->DefaultLandMovementMode = EMovementMode::MOVE_None;
 
 		//Unbind the move function
+		m_pCurrentMaterialStateDescription = nullptr;
 		m_MoveFunction.Unbind();
+		m_bIsNativeMoveDispatchSafe = false;
+
+		//No state record to read anymore
+		m_iCurrentMaterialStateIndex = INDEX_NONE;
 
 		UE_LOG(LogMaterialStateMachine, Warning, TEXT("ADropletPlayerCharacter::SetMaterialState: eNewMaterialState is EDropletMaterialState_None"));
 	}
@@ -123,15 +210,157 @@ void ADropletPlayerCharacter::BeginPlay()
 {
 	Super::BeginPlay();
 
+	//If the base class registered the default context again after the possession, go back to the current state's one only
+	if (m_pDropletPlayerController != nullptr && m_pEnhancedInputSubsystem.IsValid())
+	{
+		ChangeInputMappingContext(m_pDropletPlayerController->GetMaterialState());
+	}
+
 	// Reassign the pInteractableRangeSphereComponent cause the pInteractableRangeSphereComponent
 	// seems to not be the same as the one created in the constructor
 	pInteractableRangeSphereComponent = FindComponentByClass<USphereComponent>();
+
+	// Stream in the meshes and materials of every state in the background
+	RequestMaterialStateAssets(EDropletMaterialState::EDropletMaterialState_Liquid);
+	RequestMaterialStateAssets(EDropletMaterialState::EDropletMaterialState_Solid);
+	RequestMaterialStateAssets(EDropletMaterialState::EDropletMaterialState_Gazeous);
+
+	// Create the single material of the blended state material mode before preparing the render resources with it
+	CreateBlendedStateMaterial();
+
+	// Prepare the render resources of the states already loaded now, the others are prepared once streamed in
+	PrewarmMaterialStateRenderResources(EDropletMaterialState::EDropletMaterialState_Liquid);
+	PrewarmMaterialStateRenderResources(EDropletMaterialState::EDropletMaterialState_Solid);
+	PrewarmMaterialStateRenderResources(EDropletMaterialState::EDropletMaterialState_Gazeous);
+
+	// Drop the streamed assets of the other states under memory pressure
+	FCoreDelegates::GetMemoryTrimDelegate().AddUObject(this, &ADropletPlayerCharacter::OnMemoryTrim);
+
+	// Rebuild the line trace Query Parameters when child actors are created or destroyed instead of checking them every frame
+	if (UWorld* pWorld = GetWorld())
+	{
+		m_ActorSpawnedHandle = pWorld->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &ADropletPlayerCharacter::OnWorldActorSpawned));
+		m_ActorDestroyedHandle = pWorld->AddOnActorDestroyedHandler(FOnActorDestroyed::FDelegate::CreateUObject(this, &ADropletPlayerCharacter::OnWorldActorDestroyed));
+	}
+
+	// Create the StaminaComponent of every state up front, the state changes only activate one of them
+	CreateStaminaComponents();
+
+	if (GetStaminaComponent() == nullptr && m_StaminaComponentPool[0] != nullptr)
+	{
+		SetStaminaComponentActive(m_StaminaComponentPool[0], true);
+	}
+
+	// Create the interactable markers up front so slide dashes and drills don't allocate them
+	GetPooledInteractableMarker<UBreakerInteractableMarker>();
+	GetPooledInteractableMarker<UDrillerInteractableMarker>();
+
+	// Track the interactable actors entering and leaving the range instead of polling the overlaps every frame
+	if (pInteractableRangeSphereComponent != nullptr)
+	{
+		pInteractableRangeSphereComponent->OnComponentBeginOverlap.AddDynamic(this, &ADropletPlayerCharacter::OnInteractableRangeBeginOverlap);
+		pInteractableRangeSphereComponent->OnComponentEndOverlap.AddDynamic(this, &ADropletPlayerCharacter::OnInteractableRangeEndOverlap);
+
+		// Add the actors which were already in range before the events were bound
+		TArray<AActor*> overlappingActors;
+		pInteractableRangeSphereComponent->GetOverlappingActors(overlappingActors);
+
+		for (AActor* pActor : overlappingActors)
+		{
+			AddInteractableCandidate(pActor);
+		}
+	}
+}
+
+void ADropletPlayerCharacter::PostLoad()
+{
+	Super::PostLoad();
+
+	// Move a hard reference to its streamed reference unless that one is already set
+	auto MigrateToSoft = []<typename T>(TObjectPtr<T>& pHardAsset, TSoftObjectPtr<T>& softAsset)
+	{
+		if (pHardAsset != nullptr && softAsset.IsNull())
+		{
+			softAsset = pHardAsset.Get();
+		}
+
+		pHardAsset = nullptr;
+	};
+
+	MigrateToSoft(m_pLiquidMaterialInstance_DEPRECATED, m_LiquidMaterialInstanceSoft);
+	MigrateToSoft(m_pSolidMaterialInstance_DEPRECATED, m_SolidMaterialInstanceSoft);
+	MigrateToSoft(m_pGazeousMaterialInstance_DEPRECATED, m_GazeousMaterialInstanceSoft);
+	MigrateToSoft(m_pLiquidSKInstance_DEPRECATED, m_LiquidSKInstanceSoft);
+	MigrateToSoft(m_pSolidSKInstance_DEPRECATED, m_SolidSKInstanceSoft);
+}
+
+void ADropletPlayerCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Don't leave the interactable components with a registered character which is gone
+	FlushInteractableRegistration();
+
+	FCoreDelegates::GetMemoryTrimDelegate().RemoveAll(this);
+
+	// Give the inactive state components back to the character so they end their play and are destroyed with it
+	for (UStaminaComponent* pStaminaComponent : m_StaminaComponentPool)
+	{
+		if (pStaminaComponent != nullptr)
+		{
+			AddOwnedComponent(pStaminaComponent);
+		}
+	}
+
+	if (UWorld* pWorld = GetWorld())
+	{
+		pWorld->RemoveOnActorSpawnedHandler(m_ActorSpawnedHandle);
+		pWorld->RemoveOnActorDestroyedHandler(m_ActorDestroyedHandle);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void ADropletPlayerCharacter::Tick(float fDeltaTime)
 {
+	// Send the input of the replay frame before the Tick, as the player input would be
+	if (m_pReplayPlayer.IsValid())
+	{
+		UpdateReplayPlayback();
+	}
+
+#if !UE_BUILD_SHIPPING
+	// Send the scripted input of the benchmark before timing the Tick
+	if (m_bIsBenchmarkScriptRunning || m_bIsBenchmarkRecording)
+	{
+		UpdateBenchmarkScript(fDeltaTime);
+	}
+#endif
+
+	DROPLET_SCOPE(STAT_DropletTick, "Droplet::Tick");
+	DROPLET_BENCHMARK_SCOPE(EDropletBenchmarkSection_Tick);
+
 	Super::Tick(fDeltaTime);
 
+	// Record the metrics of the frame once the Tick is done, whichever branch it returns from
+	ON_SCOPE_EXIT
+	{
+		RecordCsvStats();
+		EndReplayFrame(fDeltaTime);
+	};
+
+#if DO_GUARD_SLOW
+	// Check the cached component handles against the real components
+	VerifyComponentHandles();
+#endif
+
+	// Push the blended state material parameters while a state change blend is running
+	UpdateStateMaterialBlend(fDeltaTime);
+
+	// Destroy the state warm up components whose pipeline states are compiled
+	if (!m_MaterialStateWarmUpComponents.IsEmpty())
+	{
+		ReleaseMaterialStateWarmUpComponents();
+	}
+
 	//If the DropletPlayerController is not registered
 	if (m_pDropletPlayerController == nullptr)
 	{
@@ -139,6 +368,15 @@ void ADropletPlayerCharacter::Tick(float fDeltaTime)
 		UE_LOG(LogTemp, Warning, TEXT("ADropletPlayerCharacter::Tick: m_pDropletPlayerController is not registered!"));
 	}
 
+	// Submit the probe ring for the next frame once the Tick is done, whichever branch it returns from
+	ON_SCOPE_EXIT
+	{
+		if (m_bUseAsyncGroundProbe && m_eGroundSensingMode == EDropletGroundSensingMode::EDropletGroundSensingMode_RayRing && !m_bIsSplashing && !m_bIsSlideDashing && !IsGroundProbeCacheValid() &&
+			GetCharacterMovement() != nullptr && GetCharacterMovement()->IsMovingOnGround())
+		{
+			SubmitAsyncGroundProbe();
+		}
+	};
 
 	// If the interactable debug is enabled
 	if (m_bIsInteractablesDebugEnabled)
@@ -160,6 +398,10 @@ void ADropletPlayerCharacter::Tick(float fDeltaTime)
 	}
 
 
+	// Report the memory of the marker and interactable arrays
+	SET_MEMORY_STAT(STAT_DropletInteractableMarkersMemory, m_InteractableMarkers.GetAllocatedSize() + m_InteractableMarkerPool.GetAllocatedSize());
+	SET_MEMORY_STAT(STAT_DropletInteractableCandidatesMemory, m_InteractableCandidates.GetAllocatedSize());
+
 	// Check and handle if we have to display interaction actions
 	HandleInteractionButtonDisplay();
 
@@ -206,54 +448,46 @@ void ADropletPlayerCharacter::Tick(float fDeltaTime)
 			return;
 		}
 
+		// The DropletCharacterMovementComponent runs the splash, slide dash and fall speed rules during the movement simulation,
+		// else they are applied here on the velocity of the frame
+		const bool bIsMovementDrivingRules = pCharacterMovementComponent->IsA<UDropletCharacterMovementComponent>();
+
 		// If we are splashing
 		if (m_bIsSplashing)
 		{
-			if (m_fSplashElapsedTime < m_pSpeedComponent->m_fSplashDuration)
+			if (bIsMovementDrivingRules)
 			{
-				float fCurveValue = m_pSpeedComponent->m_fCurveSplashSpeedBoost->GetFloatValue(m_fSplashElapsedTime / m_pSpeedComponent->m_fSplashDuration);
-
-				// Compute the speed for this frame
-				float fSpeed = m_fSplashStartSpeed + (m_fSplashTargetSpeed * fCurveValue);
-				fSpeed = FMath::Max(fSpeed, 0.f);
-
-				pCharacterMovementComponent->Velocity = m_vSplashDirection * fCurveValue * m_fSplashTargetSpeed;
-
-				m_fSplashElapsedTime += fDeltaTime;
-
 				return;
 			}
-			else
+
+			FVector vSplashVelocity;
+			if (ComputeSplashVelocity(fDeltaTime, vSplashVelocity))
 			{
-				m_bIsSplashing = false;
-				m_fSplashElapsedTime = 0.f;
+				pCharacterMovementComponent->Velocity = vSplashVelocity;
+				return;
 			}
 		}
 
 		//If we are grounded
 		if (pCharacterMovementComponent->IsMovingOnGround())
 		{
+			DROPLET_SCOPE(STAT_DropletTickGrounded, "Droplet::TickGrounded");
+
 			m_bCanSplash = false;
 
 			// If we are slide dashing continue computing the velocity
 			if (m_bIsSlideDashing)
 			{
-				if (m_fTransitionSpeedBoostElapsedTime < m_pSpeedComponent->m_fLiquidToSolidSpeedBoostDuration)
+				if (bIsMovementDrivingRules)
 				{
-					float fCurveValue = m_pSpeedComponent->m_fCurveLiquidToSolidSpeedBoost->
-						GetFloatValue(m_fTransitionSpeedBoostElapsedTime / m_pSpeedComponent->m_fLiquidToSolidSpeedBoostDuration);
-
-					pCharacterMovementComponent->Velocity = m_vTransitionSpeedBoostStartVelocity +
-						pCharacterMovementComponent->Velocity.GetSafeNormal() * fCurveValue * m_fTransitionSpeedBoostTarget;
-
-					m_fTransitionSpeedBoostElapsedTime += fDeltaTime;
-
 					return;
 				}
-				else
+
+				FVector vSlideDashVelocity;
+				if (ComputeSlideDashVelocity(fDeltaTime, pCharacterMovementComponent->Velocity, vSlideDashVelocity))
 				{
-					m_bIsSlideDashing = false;
-					m_fTransitionSpeedBoostElapsedTime = 0.f;
+					pCharacterMovementComponent->Velocity = vSlideDashVelocity;
+					return;
 				}
 			}
 
@@ -261,49 +495,47 @@ void ADropletPlayerCharacter::Tick(float fDeltaTime)
 			FVector vHitNormal;
 
 			//Adapt speed depending on the slope angle if we are not on a flat surface ---------------------------
-			float fMaxAscendingSpeed = 0.f;
-			float fMinAscendingSpeed = 0.f;
-			float fMaxDescendingSpeed = pCharacterMovementComponent->MaxWalkSpeed;
-			float fMaxFlatSpeed = pCharacterMovementComponent->MaxWalkSpeed;
-			float fAscendingFactor = 0.f;
-			float fAscendingFactorEmptyStamina = 0.f;
-			float fDescendingFactor = 0.f;
-
-			//Switch on the material state
-			EDropletMaterialState eMaterialState = m_pDropletPlayerController->GetMaterialState();
-			switch (eMaterialState)
+			//Read the current material state's values, resolved on state change
+			if (m_iCurrentMaterialStateIndex == INDEX_NONE)
 			{
-			case EDropletMaterialState::EDropletMaterialState_Liquid:
-				fMaxAscendingSpeed = m_pSpeedComponent->GetSpeedAscendingMaxLiquid();
-				fMinAscendingSpeed = m_pSpeedComponent->GetSpeedAscendingMinLiquid();
-				fMaxDescendingSpeed = m_pSpeedComponent->GetSpeedDescendingMaxLiquid();
-				fMaxFlatSpeed = m_pSpeedComponent->m_fSpeedFlatMaxLiquid;
-				fAscendingFactor = m_pSpeedComponent->m_fAscendingFactorLiquid;
-				fAscendingFactorEmptyStamina = m_pSpeedComponent->m_fAscendingFactorLiquidEmptyStamina;
-				fDescendingFactor = m_pSpeedComponent->m_fDescendingFactorLiquid;
-				break;
-			case EDropletMaterialState::EDropletMaterialState_Solid:
-				fMaxAscendingSpeed = m_pSpeedComponent->GetSpeedAscendingMaxSolid();
-				fMaxDescendingSpeed = m_pSpeedComponent->GetSpeedDescendingMaxSolid();
-				fMaxFlatSpeed = m_pSpeedComponent->m_fSpeedFlatMaxSolid;
-				fAscendingFactor = m_pSpeedComponent->m_fAscendingFactorSolid;
-				fDescendingFactor = m_pSpeedComponent->m_fDescendingFactorSolid;
-				break;
-			case EDropletMaterialState::EDropletMaterialState_Gazeous:
-				break;
-			default:
-			case EDropletMaterialState::EDropletMaterialState_None:
 				//Log error
 				UE_LOG(LogTemp, Error, TEXT("ADropletPlayerCharacter::Tick: eMaterialState is EDropletMaterialState_None"));
-				break;
 			}
 
+			const FDropletMaterialStateRecord& stateRecord = GetCurrentMaterialStateRecord();
+
+			//States without ground speeds (gazeous) keep the current MaxWalkSpeed
+			float fMaxAscendingSpeed = stateRecord.fMaxAscendingSpeed;
+			float fMinAscendingSpeed = stateRecord.fMinAscendingSpeed;
+			float fMaxDescendingSpeed = stateRecord.bHasGroundSpeeds ? stateRecord.fMaxDescendingSpeed : pCharacterMovementComponent->MaxWalkSpeed;
+			float fMaxFlatSpeed = stateRecord.bHasGroundSpeeds ? stateRecord.fMaxFlatSpeed : pCharacterMovementComponent->MaxWalkSpeed;
+			float fAscendingFactor = stateRecord.fAscendingFactor;
+			float fAscendingFactorEmptyStamina = stateRecord.fAscendingFactorEmptyStamina;
+			float fDescendingFactor = stateRecord.fDescendingFactor;
+
 			// Debug print current MaxWalkSpeed
 			if (m_pSpeedComponent->m_bAreDebugMessagesEnabled)
 			{
 				GEngine->AddOnScreenDebugMessage(-1, 0.0f, FColor::White, FString::Printf(TEXT("MaxWalkSpeed: %f"), pCharacterMovementComponent->MaxWalkSpeed));
 			}
 
+			// Debug print the ground probe cache hit rate
+			if (m_bSlopeDetectionDebugDrawLineEnabled && m_bUseGroundProbeCache)
+			{
+				GEngine->AddOnScreenDebugMessage(-1, 0.0f, FColor::White, FString::Printf(TEXT("Ground probe cache hit rate: %.1f%% (%u traces saved)"),
+					GetGroundProbeCacheHitRate() * 100.f, m_uiGroundProbeCacheHits * FDropletGroundProbe::ProbeCount));
+			}
+
+			// Debug print the cost and the disagreement of the ground sensing modes
+			if (m_bCompareGroundSensingModes)
+			{
+				GEngine->AddOnScreenDebugMessage(-1, 0.0f, FColor::White, FString::Printf(TEXT("Ground sensing: ray ring %.4f ms, shape sweep %.4f ms, angle error avg %.2f max %.2f, flat vote mismatch %u/%u"),
+					m_fGroundSensingAverageCostMs[static_cast<uint8>(EDropletGroundSensingMode::EDropletGroundSensingMode_RayRing)],
+					m_fGroundSensingAverageCostMs[static_cast<uint8>(EDropletGroundSensingMode::EDropletGroundSensingMode_ShapeSweep)],
+					m_fGroundSensingAverageAngleError, m_fGroundSensingMaxAngleError,
+					m_uiGroundSensingFlatVoteMismatchCount, m_uiGroundSensingComparisonCount));
+			}
+
 			//If we are on a slope
 			float fSlopeAngle = GetSlopeAngle(hitResult, vHitNormal);
 			if (fSlopeAngle >= m_fFlatSurfaceTolerance)
@@ -316,11 +548,11 @@ void ADropletPlayerCharacter::Tick(float fDeltaTime)
 				if (IsAscending())
 				{
 					bIsAscending = true;
-					// If we are in liquid state
-					if (m_pDropletPlayerController->GetMaterialState() == EDropletMaterialState::EDropletMaterialState_Liquid)
+					// If we are in a state slowed down by an empty stamina (liquid state)
+					if (stateRecord.bIsSlowedDownByEmptyStamina)
 					{
 						// If the stamina component is valid
-						if (UStaminaComponent* staminaComponent = Cast<UStaminaComponent>(GetComponentByClass(UStaminaComponent::StaticClass())))
+						if (UStaminaComponent* staminaComponent = GetStaminaComponent())
 						{
 							//If the stamina is empty AND the slope is inferior to max slope, we can move but slower on the slope
 							if (fSlopeAngle < m_fMaxSlopeAngle && staminaComponent->GetCurrentStamina() <= 0.f)
@@ -350,9 +582,9 @@ void ADropletPlayerCharacter::Tick(float fDeltaTime)
 					}
 
 
-					pCharacterMovementComponent->MaxWalkSpeed += bIsStaminaEmty ?
-						fAscendingFactor * FMath::Sign(m_fTargetMaxSpeed - pCharacterMovementComponent->MaxWalkSpeed) :
-						fAscendingFactorEmptyStamina * FMath::Sign(m_fTargetMaxSpeed - pCharacterMovementComponent->MaxWalkSpeed);
+					// Move towards the target speed at a constant rate, the factors are steps per frame at the reference rate
+					pCharacterMovementComponent->MaxWalkSpeed = FMath::FInterpConstantTo(pCharacterMovementComponent->MaxWalkSpeed, m_fTargetMaxSpeed, fDeltaTime,
+						(bIsStaminaEmty ? fAscendingFactor : fAscendingFactorEmptyStamina) * m_fSlopeSpeedGovernorReferenceRate);
 
 
 					float fMin = bIsTargetSpeedSuperior ? 0.f : m_fTargetMaxSpeed;
@@ -374,7 +606,9 @@ void ADropletPlayerCharacter::Tick(float fDeltaTime)
 						pCharacterMovementComponent->MaxWalkSpeed = fMaxDescendingSpeed;
 					}
 
-					pCharacterMovementComponent->MaxWalkSpeed += fDescendingFactor * FMath::Sign(m_fTargetMaxSpeed - pCharacterMovementComponent->MaxWalkSpeed);
+					// Move towards the target speed at a constant rate, the factor is a step per frame at the reference rate
+					pCharacterMovementComponent->MaxWalkSpeed = FMath::FInterpConstantTo(pCharacterMovementComponent->MaxWalkSpeed, m_fTargetMaxSpeed, fDeltaTime,
+						fDescendingFactor * m_fSlopeSpeedGovernorReferenceRate);
 
 					float fMin = bIsTargetSpeedSuperior ? 0.f : m_fTargetMaxSpeed;
 					float fMax = bIsTargetSpeedSuperior ? m_fTargetMaxSpeed : pCharacterMovementComponent->MaxWalkSpeed;
@@ -392,6 +626,8 @@ void ADropletPlayerCharacter::Tick(float fDeltaTime)
 		//If we are NOT grounded
 		else
 		{
+			DROPLET_SCOPE(STAT_DropletTickAirborne, "Droplet::TickAirborne");
+
 			//If the character is falling
 			if (GetCharacterMovement()->IsFalling())
 			{
@@ -405,8 +641,8 @@ void ADropletPlayerCharacter::Tick(float fDeltaTime)
 				FHitResult hit;
 				m_bCanSplash = !GetHitLineTracedUnder(hit, FVector::ZeroVector, m_fSplashDistanceToGroundThreshold);
 
-				//If the character is falling faster than the max falling speed
-				if (GetCharacterMovement()->Velocity.Z < -m_pSpeedComponent->m_fSpeedFallMax)
+				//If the character is falling faster than the max falling speed (already clamped by the DropletCharacterMovementComponent)
+				if (!bIsMovementDrivingRules && GetCharacterMovement()->Velocity.Z < -m_pSpeedComponent->m_fSpeedFallMax)
 				{
 					//Set it back to the max falling speed
 					GetCharacterMovement()->Velocity.Z = -m_pSpeedComponent->m_fSpeedFallMax;
@@ -449,8 +685,19 @@ void ADropletPlayerCharacter::SetupPlayerInputComponent(class UInputComponent* P
 
 void ADropletPlayerCharacter::Move(const FInputActionValue& Value)
 {
-	//If the move function is NOT bound, return
-	if (!m_MoveFunction.IsBound())
+	//If a replay drives the character, ignore the player input
+	if (IsInputOverriddenByReplay())
+	{
+		return;
+	}
+
+	if (m_pReplayRecorder.IsValid())
+	{
+		m_pReplayRecorder->RecordMove(Value.Get<FVector2D>());
+	}
+
+	//If there is no material state description to move with, return
+	if (m_pCurrentMaterialStateDescription == nullptr)
 	{
 		return;
 	}
@@ -462,7 +709,7 @@ void ADropletPlayerCharacter::Move(const FInputActionValue& Value)
 	}
 
 	// If the stamina component is valid
-	if (UStaminaComponent* staminaComponent = Cast<UStaminaComponent>(GetComponentByClass(UStaminaComponent::StaticClass())))
+	if (UStaminaComponent* staminaComponent = GetStaminaComponent())
 	{
 		//If the stamina is empty
 		if (staminaComponent->GetCurrentStamina() <= 0.f)
@@ -470,8 +717,7 @@ void ADropletPlayerCharacter::Move(const FInputActionValue& Value)
 			//If we are not in gazeous state
 			if (m_pDropletPlayerController->GetMaterialState() != EDropletMaterialState::EDropletMaterialState_Gazeous)
 			{
-				UDropletMaterialStateDescription* pDescription = UDropletMaterialStateDescription::GetMaterialStateDescriptionFromState(m_pDropletPlayerController->GetMaterialState());
-				FVector vDirection = pDescription->GetMovementDirection(Value);
+				FVector vDirection = m_pCurrentMaterialStateDescription->GetMovementDirection(Value);
 
 				bool bIsTryingToGoDownTheSlope = false;
 
@@ -511,724 +757,2236 @@ void ADropletPlayerCharacter::Move(const FInputActionValue& Value)
 	}
 
 	//Execute the move function
-	m_MoveFunction.Execute(Value);
+	DispatchMove(Value);
 }
 
-void ADropletPlayerCharacter::Jump()
+void ADropletPlayerCharacter::DispatchMove(const FInputActionValue& Value)
 {
-	if (m_bIsSplashing)
+	//If the Blueprint overridable path is used, or the state's class overrides or hides the move function, call it by name through the delegate
+	if (m_bUseReflectedMoveDispatch || !m_bIsNativeMoveDispatchSafe)
 	{
-		return;
+		m_MoveFunction.ExecuteIfBound(Value);
 	}
-
-	// If the stamina component is valid
-	if (TObjectPtr<UStaminaComponent> pStaminaComponent = Cast<UStaminaComponent>(GetComponentByClass(UStaminaComponent::StaticClass())))
+	//Else call it directly on the cached material state description
+	else if (m_pCurrentMaterialStateDescription != nullptr)
 	{
-		// If not enough stamina
-		if (pStaminaComponent->GetCurrentStamina() < pStaminaComponent->GetJumpStaminaCost() * pStaminaComponent->GetMaxStamina())
-		{
-			return;
-		}
-		// Else if we're not holding the jump yet and touching the ground, drain the stamina
-		else if (JumpKeyHoldTime == 0.f && GetCharacterMovement()->IsMovingOnGround())
-		{
-			// If infinite stamina is disabled
-			if (!pStaminaComponent->m_bIsInfiniteStaminaEnabled)
-			{
-				// Drain the stamina
-				pStaminaComponent->DrainJumpStamina();
-			}
-		}
+		m_pCurrentMaterialStateDescription->MoveFunction(Value);
 	}
-	else
+}
+
+#if !UE_BUILD_SHIPPING
+void FDropletCostSampler::AddCost(float fCostMs)
+{
+	// If a new frame started, store the previous one
+	if (uiCurrentFrameNumber != GFrameCounter)
 	{
-		//Log warning
-		UE_LOG(LogTemp, Warning, TEXT("ADropletPlayerCharacter::Jump: stamina component is nullptr!"));
+		Flush();
+		uiCurrentFrameNumber = GFrameCounter;
 	}
 
-	Super::Jump();
+	fCurrentFrameCostMs += fCostMs;
 }
 
-void ADropletPlayerCharacter::Interact()
+void FDropletCostSampler::Flush()
 {
-	// If the controller is NOT valid, return
-	if (!m_pDropletPlayerController)
+	if (uiCurrentFrameNumber == MAX_uint64)
 	{
-		UE_LOG(LogInteractable, Error, TEXT("ADropletPlayerCharacter::Interact: m_pDropletPlayerController is nullptr"));
-
 		return;
 	}
 
-	if (pInteractableRangeSphereComponent == nullptr)
+	// Overwrite the oldest frame once the ring is full
+	if (FrameCostsMs.Num() < MaxFrameCount)
 	{
-		if (m_bIsInteractablesDebugEnabled)
-		{
-			GEngine->AddOnScreenDebugMessage(-1, 1.f, FColor::Red, TEXT("ADropletPlayerCharacter::Interact: pInteractableRangeSphereComponent is nullptr"));
-		}
-
-		UE_LOG(LogInteractable, Error, TEXT("ADropletPlayerCharacter::Interact: pInteractableRangeSphereComponent is nullptr"));
-
-		return;
+		FrameCostsMs.Add(fCurrentFrameCostMs);
 	}
-
-	// Get overlapping actors in range of the InteractableRangeShapeComponent
-	TArray<TObjectPtr<AActor>> OverlappingActors;
-	pInteractableRangeSphereComponent->GetOverlappingActors(OverlappingActors, AActor::StaticClass());
-
-	// If there are actors in range of the InteractableRangeShapeComponent
-	if (!OverlappingActors.IsEmpty())
+	else
 	{
-		TArray<TObjectPtr<UInputInteractableActorComponent>> interactableComponents;
+		FrameCostsMs[iNextFrameIndex] = fCurrentFrameCostMs;
+		iNextFrameIndex = (iNextFrameIndex + 1) % MaxFrameCount;
+	}
 
-		// For each actor
-		for (AActor* pActor : OverlappingActors)
-		{
-			// Ignore itself
-			if (pActor == this)
-			{
-				continue;
-			}
+	fCurrentFrameCostMs = 0.f;
+	uiCurrentFrameNumber = MAX_uint64;
+}
 
-			// If the actor has an InputInteractableActorComponent && its root component is overlapping
-			TObjectPtr<UInputInteractableActorComponent> pInputInteractableComponent = pActor->FindComponentByClass<UInputInteractableActorComponent>();
-			if (pInputInteractableComponent != nullptr && pInteractableRangeSphereComponent->IsOverlappingComponent(CastChecked<UPrimitiveComponent>(pActor->GetRootComponent())))
-			{
-				// If we are in the range of the component
-				if (pInputInteractableComponent->IsActorInRange(this))
-				{
-					// Add it to the array
-					interactableComponents.Add(pInputInteractableComponent);
-				}
-				else
-				{
-					if (m_bIsInteractablesDebugEnabled)
-					{
-						// Add debug to screen
-						GEngine->AddOnScreenDebugMessage(-1, 1.f, FColor::Yellow, FString::Printf(TEXT("ADropletPlayerCharacter::Interact: not in range to interact with %s"), *pActor->GetName()));
-					}
-				}
-			}
-		}
+void FDropletCostSampler::Reset()
+{
+	FrameCostsMs.Reset();
+	iNextFrameIndex = 0;
+	fCurrentFrameCostMs = 0.f;
+	uiCurrentFrameNumber = MAX_uint64;
+}
 
-		// If we have interactable components in range
-		if (!interactableComponents.IsEmpty())
-		{
-			// Sort the array by distance of their owner's root component to this character
-			interactableComponents.Sort([&](const UInputInteractableActorComponent& A, const UInputInteractableActorComponent& B) {
-				return FVector::DistSquared(A.GetOwner()->GetRootComponent()->GetComponentLocation(), GetRootComponent()->GetComponentLocation()) < FVector::DistSquared(B.GetOwner()->GetRootComponent()->GetComponentLocation(), GetRootComponent()->GetComponentLocation());
-				});
+float FDropletCostSampler::GetPercentile(float fPercentile) const
+{
+	if (FrameCostsMs.IsEmpty())
+	{
+		return 0.f;
+	}
 
+	TArray<float> sortedCostsMs = FrameCostsMs;
+	sortedCostsMs.Sort();
 
-			if (m_bIsInteractablesDebugEnabled)
-			{
-				GEngine->AddOnScreenDebugMessage(-1, 1.f, FColor::Yellow, FString::Printf(TEXT("ADropletPlayerCharacter::Interact: interact with %s"), *interactableComponents[0]->GetOwner()->GetName()));
+	// Nearest rank
+	int32 iRank = FMath::CeilToInt32(FMath::Clamp(fPercentile, 0.f, 100.f) / 100.f * sortedCostsMs.Num());
+	return sortedCostsMs[FMath::Clamp(iRank - 1, 0, sortedCostsMs.Num() - 1)];
+}
+#endif // !UE_BUILD_SHIPPING
 
-				FVector loc = interactableComponents[0]->GetOwner()->GetActorLocation();
-				DrawDebugLine(
-					GetWorld(),
-					loc,
-					loc + FVector::UpVector * 250.f,
-					FColor(255, 255, 0),
-					false, 1.f, 0,
-					20
-				);
-			}
+void ADropletPlayerCharacter::CountIssuedTrace() const
+{
+	INC_DWORD_STAT(STAT_DropletTracesIssued);
 
-			// If the first component is active, interact with it
-			if (interactableComponents[0]->IsActive())
-			{
-				interactableComponents[0]->Interact(this);
-			}
-			// Else interact with the next component if it exists and is active
-			else if (interactableComponents.IsValidIndex(1) && interactableComponents[1]->IsActive())
-			{
-				interactableComponents[1]->Interact(this);
-			}
-			// Else interact with the first component in the array 
-			else
-			{
-				interactableComponents[0]->Interact(this);
-			}
-		}
+	// Restart the count on a new frame
+	if (m_uiIssuedTraceCountFrame != GFrameCounter)
+	{
+		m_uiIssuedTraceCountFrame = GFrameCounter;
+		m_uiIssuedTraceCount = 0;
 	}
+
+	++m_uiIssuedTraceCount;
 }
 
-void ADropletPlayerCharacter::HandleInteractionButtonDisplay()
+void ADropletPlayerCharacter::RecordCsvStats() const
 {
-	if (pInteractableRangeSphereComponent == nullptr)
+#if CSV_PROFILER
+	if (CVarDropletCsvStats.GetValueOnGameThread() == 0)
 	{
-		if (m_bIsInteractablesDebugEnabled)
-		{
-			GEngine->AddOnScreenDebugMessage(-1, 1.f, FColor::Red, TEXT("ADropletPlayerCharacter::HandleInteractActionDisplay: pInteractableRangeSphereComponent is nullptr"));
-		}
-
-		UE_LOG(LogInteractable, Error, TEXT("ADropletPlayerCharacter::HandleInteractActionDisplay: pInteractableRangeSphereComponent is nullptr"));
-
 		return;
 	}
 
-	// Get overlapping actors in range of the InteractableRangeShapeComponent
-	TArray<TObjectPtr<AActor>> OverlappingActors;
-	pInteractableRangeSphereComponent->GetOverlappingActors(OverlappingActors, AActor::StaticClass());
-
-	// If there are actors in range of the InteractableRangeShapeComponent
-	if (!OverlappingActors.IsEmpty())
-	{
-		TArray<TObjectPtr<UInputInteractableActorComponent>> interactableComponents;
-		TArray<TObjectPtr<UInputInteractableActorComponent>> nonInteractableComponents;
-
-		// For each actor
-		for (AActor* pActor : OverlappingActors)
-		{
-			// Ignore itself
-			if (pActor == this)
-			{
-				continue;
-			}
-
-			// If the actor has an InputInteractableActorComponent && its root component is overlapping
-			TObjectPtr<UInputInteractableActorComponent> pInputInteractableComponent = pActor->FindComponentByClass<UInputInteractableActorComponent>();
-			if (pInputInteractableComponent != nullptr && pInteractableRangeSphereComponent->IsOverlappingComponent(CastChecked<UPrimitiveComponent>(pActor->GetRootComponent())))
-			{
-				// If we are in the range of the component
-				// and not both in gazeous state and the component is an input dialogue component
-				bool bGazeous = m_pDropletPlayerController->GetMaterialState() == EDropletMaterialState::EDropletMaterialState_Gazeous;
-				bool bIsInputDialogueComponent = pActor->FindComponentByClass<UVeinDialogueActorComponent>() != nullptr;
-				if (!(bGazeous && bIsInputDialogueComponent) && pInputInteractableComponent->IsActorInRange(this))
-				{
-					// Add it to the array
-					interactableComponents.Add(pInputInteractableComponent);
-				}
-				else
-				{
-					nonInteractableComponents.Add(pInputInteractableComponent);
-				}
-			}
-			// If the actor has an InputInteractableActorComponent && its root component is not overlapping
-			else if (pInputInteractableComponent != nullptr)
-			{
-				nonInteractableComponents.Add(pInputInteractableComponent);
-			}
-		}
-
-		// If we have interactable components in range
-		if (!interactableComponents.IsEmpty())
-		{
-			// Sort the array by distance of their owner's root component to this character
-			interactableComponents.Sort([&](const UInputInteractableActorComponent& A, const UInputInteractableActorComponent& B) {
-				return FVector::DistSquared(A.GetOwner()->GetRootComponent()->GetComponentLocation(), GetRootComponent()->GetComponentLocation()) < FVector::DistSquared(B.GetOwner()->GetRootComponent()->GetComponentLocation(), GetRootComponent()->GetComponentLocation());
-				});
-
-			// Check for the first interactable component active in range
-			int iFirstActiveIndex = -1;
-			for (int i = 0; i < interactableComponents.Num(); ++i)
-			{
-				if (interactableComponents[i]->IsActive())
-				{
-					// Add debug to screen
-					if (m_bIsInteractablesDebugEnabled)
-					{
-						GEngine->AddOnScreenDebugMessage(-1, 1.f, FColor::Yellow, FString::Printf(TEXT("ADropletPlayerCharacter::HandleInteractActionDisplay: interact with %s"), *interactableComponents[iFirstActiveIndex]->GetOwner()->GetName()));
-					}
+	const UCharacterMovementComponent* pCharacterMovementComponent = GetCharacterMovement();
+	const EDropletMaterialState eMaterialState = m_pDropletPlayerController != nullptr ? m_pDropletPlayerController->GetMaterialState() : EDropletMaterialState::EDropletMaterialState_None;
 
-					iFirstActiveIndex = i;
-					break;
-				}
-			}
+	CSV_CUSTOM_STAT(Droplet, MaterialState, static_cast<int32>(eMaterialState), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Droplet, MaxWalkSpeed, pCharacterMovementComponent != nullptr ? pCharacterMovementComponent->MaxWalkSpeed : 0.f, ECsvCustomStatOp::Set);
+	// Slope angle of the last ground probe, it is not fired again for the capture
+	CSV_CUSTOM_STAT(Droplet, SlopeAngle, m_GroundProbe.fSlopeAngle, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Droplet, TracesIssued, m_uiIssuedTraceCountFrame == GFrameCounter ? static_cast<int32>(m_uiIssuedTraceCount) : 0, ECsvCustomStatOp::Set);
+	// Overlaps of the interactable range sphere, one per overlapped component, read without gathering the actors
+	CSV_CUSTOM_STAT(Droplet, RangeOverlaps, pInteractableRangeSphereComponent != nullptr ? pInteractableRangeSphereComponent->GetOverlapInfos().Num() : 0, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Droplet, InteractableCandidates, m_InteractableCandidates.Num(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Droplet, IsSplashing, m_bIsSplashing ? 1 : 0, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Droplet, IsSlideDashing, m_bIsSlideDashing ? 1 : 0, ECsvCustomStatOp::Set);
 
-			if (m_bIsInteractablesDebugEnabled)
-			{
-				FVector loc = interactableComponents[0]->GetOwner()->GetActorLocation();
-				DrawDebugLine(
-					GetWorld(),
-					loc,
-					loc + FVector::UpVector * 200.f,
-					FColor(0, 255, 0),
-					false, -1.f, 0,
-					12.333
-				);
-			}
+	// Cost and disagreement of the ground sensing modes, while they are compared
+	if (m_bCompareGroundSensingModes)
+	{
+		CSV_CUSTOM_STAT(Droplet, GroundSensingRayRingMs, m_fGroundSensingAverageCostMs[static_cast<uint8>(EDropletGroundSensingMode::EDropletGroundSensingMode_RayRing)], ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(Droplet, GroundSensingShapeSweepMs, m_fGroundSensingAverageCostMs[static_cast<uint8>(EDropletGroundSensingMode::EDropletGroundSensingMode_ShapeSweep)], ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(Droplet, GroundSensingAngleError, m_fGroundSensingAverageAngleError, ECsvCustomStatOp::Set);
+	}
+#endif
+}
 
-			// Register the character to the first active interactable component if any
-			if (iFirstActiveIndex > -1 && iFirstActiveIndex < interactableComponents.Num() &&
-				m_pDropletPlayerController->GetMaterialState() != EDropletMaterialState::EDropletMaterialState_Gazeous)
-			{
-				interactableComponents[iFirstActiveIndex]->RegisterCharacterForInteraction(this);
-			}
+#if !UE_BUILD_SHIPPING
+FDropletCostSampler* ADropletPlayerCharacter::GetBenchmarkSampler(EDropletBenchmarkSection eSection) const
+{
+	return m_bIsBenchmarkRecording ? &m_BenchmarkSamplers[static_cast<uint8>(eSection)] : nullptr;
+}
 
-			// Unregister the character from the other interactable components
-			for (int i = 0; i < interactableComponents.Num(); ++i)
-			{
-				if (i == iFirstActiveIndex && m_pDropletPlayerController != nullptr &&
-					m_pDropletPlayerController->GetMaterialState() != EDropletMaterialState::EDropletMaterialState_Gazeous)
-				{
-					continue;
-				}
+void ADropletPlayerCharacter::DropletBenchmarkStart(int32 bRunScript /* = 1 */)
+{
+	for (FDropletCostSampler& sampler : m_BenchmarkSamplers)
+	{
+		sampler.Reset();
+	}
 
-				interactableComponents[i]->UnregisterCharacter(this);
-			}
-		}
+	m_bIsBenchmarkRecording = true;
+	m_bIsBenchmarkScriptRunning = bRunScript != 0;
+	m_fBenchmarkElapsedTime = 0.f;
+	m_fBenchmarkDuration = 0.f;
+	m_bQuitWhenBenchmarkDone = false;
 
-		// Unregister the character from the non-interactable components
-		for (UInputInteractableActorComponent* pNonInteractableComponent : nonInteractableComponents)
-		{
-			pNonInteractableComponent->UnregisterCharacter(this);
-		}
-	}
+	UE_LOG(LogTemp, Log, TEXT("ADropletPlayerCharacter::DropletBenchmarkStart: recording%s"), m_bIsBenchmarkScriptRunning ? TEXT(" with the input script") : TEXT(""));
 }
 
-void ADropletPlayerCharacter::ChangeMaterialState(const FInputActionValue& Value)
+void ADropletPlayerCharacter::DropletBenchmarkStop()
 {
-	//If the controller is NOT valid, return
-	if (!m_pDropletPlayerController)
+	if (!m_bIsBenchmarkRecording)
 	{
+		UE_LOG(LogTemp, Warning, TEXT("ADropletPlayerCharacter::DropletBenchmarkStop: the benchmark is not running"));
 		return;
 	}
 
-	if (Value.IsNonZero())
+	m_bIsBenchmarkRecording = false;
+	m_bIsBenchmarkScriptRunning = false;
+
+	static const TCHAR* SectionNames[] = { TEXT("Tick"), TEXT("GetSlopeAngle"), TEXT("HandleInteractionButtonDisplay"), TEXT("SetMaterialState") };
+	static_assert(UE_ARRAY_COUNT(SectionNames) == static_cast<uint8>(EDropletBenchmarkSection::EDropletBenchmarkSection_Count), "One name per benchmark section");
+
+	// One line per section, frames where a section didn't run are not counted
+	for (int i = 0; i < UE_ARRAY_COUNT(SectionNames); ++i)
 	{
-		FVector VectorValue = Value.Get<FVector>();
+		FDropletCostSampler& sampler = m_BenchmarkSamplers[i];
+		sampler.Flush();
 
-		//Change the material state
-		m_pDropletPlayerController->PlayerChangeMaterialState(VectorValue.X > 0 ? false : true);
+		UE_LOG(LogTemp, Display, TEXT("DropletBenchmark: %s frames=%d p50=%.4f p90=%.4f p99=%.4f max=%.4f ms"),
+			SectionNames[i], sampler.FrameCostsMs.Num(), sampler.GetPercentile(50.f), sampler.GetPercentile(90.f), sampler.GetPercentile(99.f), sampler.GetPercentile(100.f));
+	}
+
+	if (m_bQuitWhenBenchmarkDone)
+	{
+		FPlatformMisc::RequestExit(false);
 	}
 }
 
-void ADropletPlayerCharacter::PossessedBy(AController* pNewController)
+void ADropletPlayerCharacter::DropletBenchmarkRun(float fDuration /* = 30.f */, int32 bQuitWhenDone /* = 0 */)
 {
-	Super::PossessedBy(pNewController);
+	DropletBenchmarkStart(1);
 
-	//If the controller is a ADropletPlayerController
-	if (ADropletPlayerController* castedController = CastChecked<ADropletPlayerController>(pNewController))
-	{
-		m_pDropletPlayerController = castedController;
-	}
+	m_fBenchmarkDuration = FMath::Max(fDuration, 0.f);
+	m_bQuitWhenBenchmarkDone = bQuitWhenDone != 0;
 }
 
-void ADropletPlayerCharacter::Splash(const FHitResult& Hit)
+void ADropletPlayerCharacter::UpdateBenchmarkScript(float fDeltaTime)
 {
-	FVector vHitNormal = Hit.ImpactNormal;
+	const float fPreviousTime = m_fBenchmarkElapsedTime;
+	m_fBenchmarkElapsedTime += fDeltaTime;
 
-	// If the CharacterMovementComponent is valid
-	TObjectPtr<UCharacterMovementComponent> pCharacterMovement = GetCharacterMovement();
-	if (pCharacterMovement != nullptr)
+	// If the run is over, log the results
+	if (m_fBenchmarkDuration > 0.f && m_fBenchmarkElapsedTime >= m_fBenchmarkDuration)
 	{
-		// Get the angle between the hit normal and the character velocity
-		float fAngle = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(vHitNormal, -pCharacterMovement->Velocity.GetSafeNormal())));
+		DropletBenchmarkStop();
+		return;
+	}
 
-		// Get the character direction
-		FVector vCharacterDirection = pCharacterMovement->Velocity;
-		// Remove the Z coordinate
-		vCharacterDirection.Z = 0.f;
+	if (!m_bIsBenchmarkScriptRunning)
+	{
+		return;
+	}
 
-		// Get the angle between the character direction and the hit normal
-		float fAngleBetweenCharacterDirectionAndHitNormal = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(vHitNormal, vCharacterDirection.GetSafeNormal())));
+	// Returns true on the frame a multiple of fInterval is crossed
+	auto HasCrossed = [fPreviousTime, this](float fInterval)
+	{
+		return FMath::FloorToInt32(fPreviousTime / fInterval) != FMath::FloorToInt32(m_fBenchmarkElapsedTime / fInterval);
+	};
 
-		// Compute the splash direction to which the character will be boosted
-		m_vSplashDirection = vCharacterDirection.RotateAngleAxis(90.f - fAngleBetweenCharacterDirectionAndHitNormal, FVector::UpVector.Cross(vCharacterDirection).GetSafeNormal());
-		m_vSplashDirection = m_vSplashDirection.GetSafeNormal();
+	// Move forward while slowly weaving so the character goes over the slopes and stairs of the map
+	Move(FInputActionValue(FVector2D(FMath::Sin(m_fBenchmarkElapsedTime * 0.5f), 1.f)));
 
-		if (m_bIsSplashDebugDrawLineEnabled)
-		{
-			// Draw a debug line to show the splash direction
-			DrawDebugLine(GetWorld(), GetActorLocation(), GetActorLocation() + m_vSplashDirection * 100.f, FColor::Green, false, 3.f, 0, 12.333f);
-			DrawDebugLine(GetWorld(), GetActorLocation(), GetActorLocation() + vCharacterDirection * 100.f, FColor::Blue, false, 3.f, 0, 12.333f);
-			DrawDebugLine(GetWorld(), GetActorLocation(), GetActorLocation() + FVector::UpVector.Cross(vCharacterDirection) * 1000.f, FColor::Purple, false, 3.f, 0, 12.333f);
-		}
+	if (HasCrossed(1.f))
+	{
+		Interact();
+	}
 
-		// If the SpeedComponent is valid
-		if (m_pSpeedComponent != nullptr)
-		{
-			bool bIsAscending = m_vSplashDirection.Z > 0.f;
+	if (HasCrossed(2.f))
+	{
+		Jump();
+	}
 
-			// If the angle is within the the failure range or we are ascending
-			if (fAngle < 90.f - m_pSpeedComponent->m_fSplashAngleFailureThreshold || bIsAscending)
-			{
-				m_fSplashTargetSpeed = pCharacterMovement->Velocity.Size() - pCharacterMovement->Velocity.Size() * m_pSpeedComponent->m_fSplashSpeedBoostFactor;
+	// Alternate between going to the next and the previous material state
+	if (HasCrossed(3.f))
+	{
+		ChangeMaterialState(FInputActionValue(FVector(FMath::FloorToInt32(m_fBenchmarkElapsedTime / 3.f) % 2 == 0 ? 1.f : -1.f, 0.f, 0.f)));
+	}
+}
+#else
+void ADropletPlayerCharacter::DropletBenchmarkStart(int32 bRunScript /* = 1 */)
+{
+	UE_LOG(LogTemp, Warning, TEXT("ADropletPlayerCharacter::DropletBenchmarkStart: the benchmark is not available in Shipping builds"));
+}
 
-				m_bIsSplashing = true;
+void ADropletPlayerCharacter::DropletBenchmarkStop()
+{
+	UE_LOG(LogTemp, Warning, TEXT("ADropletPlayerCharacter::DropletBenchmarkStop: the benchmark is not available in Shipping builds"));
+}
 
-				if (m_pSpeedComponent->m_bAreDebugMessagesEnabled)
-				{
-					GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, FString::Printf(TEXT("Splash angle: %f"), 90.f - fAngle));
-					GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, FString::Printf(TEXT("Splash speed boost: %f"), m_fSplashTargetSpeed));
-				}
-			}
-			// Else if the angle is within the success range
-			else if (fAngle >= 90.f - m_pSpeedComponent->m_fSplashAngleSuccessThreshold)
-			{
-				m_fSplashStartSpeed = pCharacterMovement->Velocity.Size();
-				m_fSplashTargetSpeed = pCharacterMovement->Velocity.Size() + pCharacterMovement->Velocity.Size() * m_pSpeedComponent->m_fSplashSpeedBoostFactor;
+void ADropletPlayerCharacter::DropletBenchmarkRun(float fDuration /* = 30.f */, int32 bQuitWhenDone /* = 0 */)
+{
+	UE_LOG(LogTemp, Warning, TEXT("ADropletPlayerCharacter::DropletBenchmarkRun: the benchmark is not available in Shipping builds"));
+}
+#endif // !UE_BUILD_SHIPPING
 
-				m_bIsSplashing = true;
+void ADropletPlayerCharacter::DropletReplayRecord(int32 bRingMode /* = 0 */)
+{
+	m_pReplayRecorder = MakeUnique<FDropletReplayRecorder>();
+	m_pReplayRecorder->Start(bRingMode != 0, m_iReplayMaxChunkBytes, m_iReplayMaxChunkCount, m_iReplayKeyframeInterval);
 
-				if (m_pSpeedComponent->m_bAreDebugMessagesEnabled)
-				{
-					GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Green, FString::Printf(TEXT("Splash angle: %f"), 90.f - fAngle));
-					GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Green, FString::Printf(TEXT("Splash speed boost: %f"), m_fSplashTargetSpeed));
-				}
-			}
-			else if (m_pSpeedComponent->m_bAreDebugMessagesEnabled)
-			{
-				GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Yellow, FString::Printf(TEXT("Splash angle: %f"), 90.f - fAngle));
-			}
-		}
+	UE_LOG(LogTemp, Log, TEXT("ADropletPlayerCharacter::DropletReplayRecord: recording%s"), bRingMode != 0 ? TEXT(" the last chunks") : TEXT(""));
+}
+
+void ADropletPlayerCharacter::DropletReplayStop(const FString& FileName /* = TEXT("") */)
+{
+	//If a replay plays, give the input back to the player
+	if (m_pReplayPlayer.IsValid())
+	{
+		m_pReplayPlayer.Reset();
+		UE_LOG(LogTemp, Log, TEXT("ADropletPlayerCharacter::DropletReplayStop: playback stopped"));
+	}
+
+	if (!m_pReplayRecorder.IsValid())
+	{
+		return;
 	}
+
+	m_pReplayRecorder->Stop();
+
+	const FString fileName = FileName.IsEmpty() ? FString::Printf(TEXT("Droplet_%s.dreplay"), *FDateTime::Now().ToString()) : FileName;
+	m_pReplayRecorder->SaveToFileAsync(FPaths::ProjectSavedDir() / TEXT("Replays") / fileName);
+
+	m_pReplayRecorder.Reset();
 }
 
-void ADropletPlayerCharacter::ChangeInputMappingContext(EDropletMaterialState eNewMaterialState)
+void ADropletPlayerCharacter::DropletReplayPlay(const FString& FileName)
 {
-	UInputMappingContext* pInputMappingContext = nullptr;
+	const FString filePath = FPaths::IsRelative(FileName) ? FPaths::ProjectSavedDir() / TEXT("Replays") / FileName : FileName;
 
-	//Switch on the material state
-	switch (eNewMaterialState)
+	TUniquePtr<FDropletReplayPlayer> pReplayPlayer = MakeUnique<FDropletReplayPlayer>();
+	if (!pReplayPlayer->LoadFromFile(filePath))
 	{
-		//If the material state is solid
-	case EDropletMaterialState::EDropletMaterialState_Solid:
+		return;
+	}
+
+	m_pReplayPlayer = MoveTemp(pReplayPlayer);
+	m_bIsReplayStarting = true;
+
+	UE_LOG(LogTemp, Log, TEXT("ADropletPlayerCharacter::DropletReplayPlay: playing %s"), *filePath);
+}
+
+void ADropletPlayerCharacter::UpdateReplayPlayback()
+{
+	//If the replay is over, give the input back to the player
+	if (!m_pReplayPlayer->ReadNextFrame(m_CurrentReplayFrame))
 	{
-		//Change the input mapping context to solid
-		pInputMappingContext = SolidMappingContext;
-		break;
+		m_pReplayPlayer.Reset();
+		UE_LOG(LogTemp, Log, TEXT("ADropletPlayerCharacter::UpdateReplayPlayback: replay over"));
+		return;
 	}
-	//If the material state is liquid
-	case EDropletMaterialState::EDropletMaterialState_Liquid:
+
+	TGuardValue<bool> applyingReplayInputGuard(m_bIsApplyingReplayInput, true);
+	const FDropletReplayFrame& frame = m_CurrentReplayFrame;
+
+	// The replay may start mid-game or, in ring mode, at any chunk, put the character in the recorded state before sending the input
+	if (m_bIsReplayStarting)
 	{
-		//Change the input mapping context to liquid
-		pInputMappingContext = LiquidMappingContext;
-		break;
+		ApplyReplayStartState(frame);
 	}
-	//If the material state is gas
-	case EDropletMaterialState::EDropletMaterialState_Gazeous:
+
+	if (frame.HasFlag(FDropletReplayFrame::Flag_Move))
 	{
-		//Change the input mapping context to gazeous
-		pInputMappingContext = GazeousMappingContext;
-		break;
+		Move(FInputActionValue(frame.vMoveValue));
 	}
-	//If the material state is none
-	default:
-	case EDropletMaterialState::EDropletMaterialState_None:
+
+	if (frame.HasFlag(FDropletReplayFrame::Flag_Jump))
 	{
-		//Change the input mapping context to default
-		pInputMappingContext = DefaultMappingContext;
-		break;
+		Jump();
 	}
+
+	if (frame.HasFlag(FDropletReplayFrame::Flag_StopJumping))
+	{
+		StopJumping();
 	}
 
-	//If the droplet player controller is valid
-	if (m_pDropletPlayerController != nullptr)
+	if (frame.HasFlag(FDropletReplayFrame::Flag_ChangeMaterialStatePositive) || frame.HasFlag(FDropletReplayFrame::Flag_ChangeMaterialStateNegative))
 	{
-		//If the local player is valid
-		if (ULocalPlayer* localPlayer = m_pDropletPlayerController->GetLocalPlayer())
-		{
-			//If the subsystem is valid
-			if (UEnhancedInputLocalPlayerSubsystem* subsystem = ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(localPlayer))
-			{
-				//Change the input mapping context
-				subsystem->ClearAllMappings();
-				subsystem->AddMappingContext(pInputMappingContext, 0);
-			}
-		}
+		ChangeMaterialState(FInputActionValue(FVector(frame.HasFlag(FDropletReplayFrame::Flag_ChangeMaterialStatePositive) ? 1.f : -1.f, 0.f, 0.f)));
 	}
-	else
+
+	if (frame.HasFlag(FDropletReplayFrame::Flag_Interact))
 	{
-		UE_LOG(LogMaterialStateMachine, Error, TEXT("ADropletPlayerCharacter::ChangeInputMappingContext: m_pDropletPlayerController is nullptr"));
+		Interact();
 	}
 }
 
-void ADropletPlayerCharacter::ChangeSkeletalMeshInstance(EDropletMaterialState eNewMaterialState)
+void ADropletPlayerCharacter::ApplyReplayStartState(const FDropletReplayFrame& frame)
 {
-	USkeletalMesh* pSKInstance = nullptr;
+	//If the first frame is not a keyframe, there is no state to start from
+	if (!frame.HasFlag(FDropletReplayFrame::Flag_Keyframe))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ADropletPlayerCharacter::ApplyReplayStartState: the replay doesn't start with a keyframe"));
+		m_bIsReplayStarting = false;
+		return;
+	}
 
-	//Switch on the material state
-	switch (eNewMaterialState)
+	// Go to the recorded state the way the player input does, the controller owns the MaterialState
+	for (int i = 0; i < MaterialStateCount && m_pDropletPlayerController != nullptr && m_pDropletPlayerController->GetMaterialState() != frame.eMaterialState; ++i)
 	{
-		//If the material state is solid
-	case EDropletMaterialState::EDropletMaterialState_Solid:
+		m_pDropletPlayerController->PlayerChangeMaterialState(false);
+	}
+
+	if (m_pDropletPlayerController == nullptr || m_pDropletPlayerController->GetMaterialState() != frame.eMaterialState)
 	{
-		//Change the material instance to solid
-		pSKInstance = m_pSolidSKInstance;
-		break;
+		UE_LOG(LogMaterialStateMachine, Warning, TEXT("ADropletPlayerCharacter::ApplyReplayStartState: couldn't enter the recorded state %d"), static_cast<int32>(frame.eMaterialState));
 	}
-	default:
-		//If the material state is none
-	case EDropletMaterialState::EDropletMaterialState_None:
-		//If the material state is liquid
-	case EDropletMaterialState::EDropletMaterialState_Liquid:
+
+	//If the recording wasn't splashing or slide dashing, end the ones the character is in, the movement goes back to its ground or falling mode
+	if (!frame.bIsSplashing && m_bIsSplashing)
 	{
-		//Change the material instance to liquid
-		pSKInstance = m_pLiquidSKInstance;
-		break;
+		EndSplash();
 	}
-	//If the material state is gas
-	case EDropletMaterialState::EDropletMaterialState_Gazeous:
+
+	if (!frame.bIsSlideDashing && m_bIsSlideDashing)
 	{
-		//Change the material instance to gazeous
-		//pSKInstance = m_pGazeousSKInstance;
+		m_bIsSlideDashing = false;
+		m_fTransitionSpeedBoostElapsedTime = 0.f;
+	}
 
-		//Do not change the mesh
-		//Make it invisible
-		this->GetMesh()->SetVisibility(false);
+	// A splash or a slide dash depends on the hit or the transition which started it, it can't be started from the keyframe
+	if ((frame.bIsSplashing && !m_bIsSplashing) || (frame.bIsSlideDashing && !m_bIsSlideDashing))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ADropletPlayerCharacter::ApplyReplayStartState: the replay starts during a splash or a slide dash, the playback starts without it"));
+	}
+}
 
-		break;
+void ADropletPlayerCharacter::EndReplayFrame(float fDeltaTime)
+{
+	if (m_pReplayRecorder.IsValid())
+	{
+		const EDropletMaterialState eMaterialState = m_pDropletPlayerController != nullptr ? m_pDropletPlayerController->GetMaterialState() : EDropletMaterialState::EDropletMaterialState_None;
+		m_pReplayRecorder->EndFrame(fDeltaTime, GetActorLocation(), GetVelocity(), GetActorRotation().Yaw, eMaterialState, m_bIsSplashing, m_bIsSlideDashing);
 	}
+
+	if (!m_pReplayPlayer.IsValid())
+	{
+		return;
 	}
 
+	const FDropletReplayFrame& frame = m_CurrentReplayFrame;
 
-	//Return if in gazeous state
-	if (eNewMaterialState == EDropletMaterialState::EDropletMaterialState_Gazeous)
+	//If the playback entered another state than the recording, log it
+	if (frame.HasFlag(FDropletReplayFrame::Flag_MaterialState) && m_pDropletPlayerController != nullptr && m_pDropletPlayerController->GetMaterialState() != frame.eMaterialState)
 	{
-		return;
+		UE_LOG(LogMaterialStateMachine, Warning, TEXT("ADropletPlayerCharacter::EndReplayFrame: the playback is in state %d, the recording entered state %d"),
+			static_cast<int32>(m_pDropletPlayerController->GetMaterialState()), static_cast<int32>(frame.eMaterialState));
 	}
 
-	//Change Character mesh
-	//If the mesh is valid
-	if (USkeletalMeshComponent* pMeshComponent = this->GetMesh())
+	//If the playback drifted from the keyframe, snap it back, always on the first frame so the playback starts where the recording did
+	if (frame.HasFlag(FDropletReplayFrame::Flag_Keyframe))
 	{
-		//If the mesh instance is valid
-		if (pSKInstance != nullptr)
-		{
-			//Change the mesh
-			pMeshComponent->SetSkeletalMesh(pSKInstance);
+		const double dDrift = FVector::Dist(GetActorLocation(), frame.vLocation);
+		const bool bIsReplayStarting = m_bIsReplayStarting;
+		m_bIsReplayStarting = false;
 
-			//Make it visible
-			pMeshComponent->SetVisibility(true);
-		}
-		else
+		if (bIsReplayStarting || (m_bCorrectReplayDrift && dDrift > m_fReplayDriftTolerance))
 		{
-			UE_LOG(LogMaterialStateMachine, Error, TEXT("ADropletPlayerCharacter::ChangeSkeletalMeshInstance: pSKInstance is nullptr"));
+			UE_LOG(LogTemp, Verbose, TEXT("ADropletPlayerCharacter::EndReplayFrame: snapped back the playback drifted by %f cm"), dDrift);
+
+			FRotator rotation = GetActorRotation();
+			rotation.Yaw = frame.fYaw;
+			SetActorLocationAndRotation(frame.vLocation, rotation, false, nullptr, ETeleportType::TeleportPhysics);
+
+			if (UCharacterMovementComponent* pCharacterMovement = GetCharacterMovement())
+			{
+				pCharacterMovement->Velocity = frame.vVelocity;
+			}
 		}
 	}
-	else
-	{
-		UE_LOG(LogMaterialStateMachine, Error, TEXT("ADropletPlayerCharacter::ChangeSkeletalMeshInstance: pMeshComponent is nullptr"));
-	}
 }
 
-void ADropletPlayerCharacter::ChangeMeshMaterialInstance(EDropletMaterialState eNewMaterialState)
+void ADropletPlayerCharacter::Jump()
 {
-	UMaterialInstance* pMaterialInstance = nullptr;
-
-	//Switch on the material state
-	switch (eNewMaterialState)
-	{
-		//If the material state is solid
-	case EDropletMaterialState::EDropletMaterialState_Solid:
+	//If a replay drives the character, ignore the player input
+	if (IsInputOverriddenByReplay())
 	{
-		//Change the material instance to solid
-		pMaterialInstance = m_pSolidMaterialInstance;
-		break;
+		return;
 	}
-	default:
-		//If the material state is none
-	case EDropletMaterialState::EDropletMaterialState_None:
-		//If the material state is liquid
-	case EDropletMaterialState::EDropletMaterialState_Liquid:
+
+	if (m_pReplayRecorder.IsValid())
 	{
-		//Change the material instance to liquid
-		pMaterialInstance = m_pLiquidMaterialInstance;
-		break;
+		m_pReplayRecorder->RecordJump();
 	}
-	//If the material state is gas
-	case EDropletMaterialState::EDropletMaterialState_Gazeous:
+
+	if (m_bIsSplashing)
 	{
-		//Change the material instance to gazeous
-		pMaterialInstance = m_pGazeousMaterialInstance;
-		break;
-	}
+		return;
 	}
 
-	//Change Character mesh's material
-	//If the mesh is valid
-	if (USkeletalMeshComponent* pMeshComponent = this->GetMesh())
+	// If the stamina component is valid
+	if (TObjectPtr<UStaminaComponent> pStaminaComponent = GetStaminaComponent())
 	{
-		//If the material instance is valid
-		if (pMaterialInstance != nullptr)
+		// If not enough stamina
+		if (pStaminaComponent->GetCurrentStamina() < pStaminaComponent->GetJumpStaminaCost() * pStaminaComponent->GetMaxStamina())
 		{
-			//Change the material instance
-			pMeshComponent->SetMaterial(0, pMaterialInstance);
+			return;
 		}
-		else
+		// Else if we're not holding the jump yet and touching the ground, drain the stamina
+		else if (JumpKeyHoldTime == 0.f && GetCharacterMovement()->IsMovingOnGround())
 		{
-			UE_LOG(LogMaterialStateMachine, Error, TEXT("ADropletPlayerCharacter::ChangeMeshMaterialInstance: pMaterialInstance is nullptr"));
+			// If infinite stamina is disabled
+			if (!pStaminaComponent->m_bIsInfiniteStaminaEnabled)
+			{
+				// Drain the stamina
+				pStaminaComponent->DrainJumpStamina();
+			}
 		}
 	}
 	else
 	{
-		UE_LOG(LogMaterialStateMachine, Error, TEXT("ADropletPlayerCharacter::ChangeMeshMaterialInstance: pMeshComponent is nullptr"));
+		//Log warning
+		UE_LOG(LogTemp, Warning, TEXT("ADropletPlayerCharacter::Jump: stamina component is nullptr!"));
+	}
+
+	Super::Jump();
+}
+
+void ADropletPlayerCharacter::StopJumping()
+{
+	//If a replay drives the character, ignore the player input
+	if (IsInputOverriddenByReplay())
+	{
+		return;
+	}
+
+	if (m_pReplayRecorder.IsValid())
+	{
+		m_pReplayRecorder->RecordStopJumping();
+	}
+
+	Super::StopJumping();
+}
+
+void ADropletPlayerCharacter::Interact()
+{
+	DROPLET_SCOPE(STAT_DropletInteract, "Droplet::Interact");
+
+	//If a replay drives the character, ignore the player input
+	if (IsInputOverriddenByReplay())
+	{
+		return;
+	}
+
+	if (m_pReplayRecorder.IsValid())
+	{
+		m_pReplayRecorder->RecordInteract();
+	}
+
+	// If the controller is NOT valid, return
+	if (!m_pDropletPlayerController)
+	{
+		UE_LOG(LogInteractable, Error, TEXT("ADropletPlayerCharacter::Interact: m_pDropletPlayerController is nullptr"));
+
+		return;
+	}
+
+	if (pInteractableRangeSphereComponent == nullptr)
+	{
+		if (m_bIsInteractablesDebugEnabled)
+		{
+			GEngine->AddOnScreenDebugMessage(-1, 1.f, FColor::Red, TEXT("ADropletPlayerCharacter::Interact: pInteractableRangeSphereComponent is nullptr"));
+		}
+
+		UE_LOG(LogInteractable, Error, TEXT("ADropletPlayerCharacter::Interact: pInteractableRangeSphereComponent is nullptr"));
+
+		return;
+	}
+
+	// Reuse this frame's selection, it is only computed here if the Tick didn't run yet
+	UpdateInteractableSelection();
+
+	// Interact with the selected active component, else with the nearest one in range
+	UInputInteractableActorComponent* pInteractableComponent = m_pSelectedInteractable.IsValid() ? m_pSelectedInteractable.Get() : m_pNearestInteractable.Get();
+
+	if (pInteractableComponent != nullptr)
+	{
+		if (m_bIsInteractablesDebugEnabled)
+		{
+			GEngine->AddOnScreenDebugMessage(-1, 1.f, FColor::Yellow, FString::Printf(TEXT("ADropletPlayerCharacter::Interact: interact with %s"), *pInteractableComponent->GetOwner()->GetName()));
+
+			FVector loc = pInteractableComponent->GetOwner()->GetActorLocation();
+			DrawDebugLine(
+				GetWorld(),
+				loc,
+				loc + FVector::UpVector * 250.f,
+				FColor(255, 255, 0),
+				false, 1.f, 0,
+				20
+			);
+		}
+
+		pInteractableComponent->Interact(this);
+	}
+	else if (m_bIsInteractablesDebugEnabled && !m_InteractableCandidates.IsEmpty())
+	{
+		// Add debug to screen
+		GEngine->AddOnScreenDebugMessage(-1, 1.f, FColor::Yellow, TEXT("ADropletPlayerCharacter::Interact: not in range to interact"));
+	}
+}
+
+void ADropletPlayerCharacter::HandleInteractionButtonDisplay()
+{
+	DROPLET_SCOPE(STAT_DropletHandleInteractionButtonDisplay, "Droplet::HandleInteractionButtonDisplay");
+	DROPLET_BENCHMARK_SCOPE(EDropletBenchmarkSection_HandleInteractionButtonDisplay);
+
+	if (pInteractableRangeSphereComponent == nullptr)
+	{
+		if (m_bIsInteractablesDebugEnabled)
+		{
+			GEngine->AddOnScreenDebugMessage(-1, 1.f, FColor::Red, TEXT("ADropletPlayerCharacter::HandleInteractActionDisplay: pInteractableRangeSphereComponent is nullptr"));
+		}
+
+		UE_LOG(LogInteractable, Error, TEXT("ADropletPlayerCharacter::HandleInteractActionDisplay: pInteractableRangeSphereComponent is nullptr"));
+
+		return;
+	}
+
+	UpdateInteractableSelection();
+
+	// We can't interact in gazeous state
+	bool bGazeous = m_pDropletPlayerController == nullptr ||
+		m_pDropletPlayerController->GetMaterialState() == EDropletMaterialState::EDropletMaterialState_Gazeous;
+
+	UInputInteractableActorComponent* pSelectedComponent = bGazeous ? nullptr : m_pSelectedInteractable.Get();
+
+	if (m_bIsInteractablesDebugEnabled)
+	{
+		// Add debug to screen
+		if (pSelectedComponent != nullptr)
+		{
+			GEngine->AddOnScreenDebugMessage(-1, 1.f, FColor::Yellow, FString::Printf(TEXT("ADropletPlayerCharacter::HandleInteractActionDisplay: interact with %s"), *pSelectedComponent->GetOwner()->GetName()));
+		}
+
+		if (UInputInteractableActorComponent* pNearestComponent = m_pNearestInteractable.Get())
+		{
+			FVector loc = pNearestComponent->GetOwner()->GetActorLocation();
+			DrawDebugLine(
+				GetWorld(),
+				loc,
+				loc + FVector::UpVector * 200.f,
+				FColor(0, 255, 0),
+				false, -1.f, 0,
+				12.333
+			);
+		}
+	}
+
+	// Only send the registration changes since the last frame to the interactable components
+	if (pSelectedComponent != m_pRegisteredInteractable.Get())
+	{
+		// Unregister the character from the component it left
+		FlushInteractableRegistration();
+
+		// Register the character to the newly selected component if any
+		if (pSelectedComponent != nullptr)
+		{
+			pSelectedComponent->RegisterCharacterForInteraction(this);
+			m_pRegisteredInteractable = pSelectedComponent;
+		}
+	}
+}
+
+void ADropletPlayerCharacter::FlushInteractableRegistration()
+{
+	if (UInputInteractableActorComponent* pRegisteredComponent = m_pRegisteredInteractable.Get())
+	{
+		pRegisteredComponent->UnregisterCharacter(this);
+	}
+
+	m_pRegisteredInteractable.Reset();
+}
+
+void ADropletPlayerCharacter::UpdateInteractableSelection()
+{
+	// Select at most once per frame, Interact reuses the selection of the Tick
+	if (m_uiInteractableSelectionFrame == GFrameCounter)
+	{
+		return;
+	}
+
+	m_uiInteractableSelectionFrame = GFrameCounter;
+
+	// Forget the candidates destroyed since they entered the range
+	PruneInteractableCandidates();
+
+	FVector vLocation = GetRootComponent()->GetComponentLocation();
+
+	UInputInteractableActorComponent* pCurrentComponent = m_pSelectedInteractable.Get();
+	const FDropletInteractableCandidate* pCurrentCandidate = nullptr;
+	const FDropletInteractableCandidate* pNearestActiveCandidate = nullptr;
+	const FDropletInteractableCandidate* pNearestCandidate = nullptr;
+
+	for (FDropletInteractableCandidate& candidate : m_InteractableCandidates)
+	{
+		UInputInteractableActorComponent* pInputInteractableComponent = candidate.pInteractableComponent.Get();
+
+		// If the actor's root component is overlapping and we are in the range of the component
+		candidate.bIsInteractable = IsInteractableCandidateRootOverlapping(candidate) && pInputInteractableComponent->IsActorInRange(this);
+
+		if (!candidate.bIsInteractable)
+		{
+			continue;
+		}
+
+		// Compute the distance of the owner's root component to this character once per candidate
+		candidate.fDistance = FVector::Dist(candidate.pActor->GetRootComponent()->GetComponentLocation(), vLocation);
+
+		if (pNearestCandidate == nullptr || candidate.fDistance < pNearestCandidate->fDistance)
+		{
+			pNearestCandidate = &candidate;
+		}
+
+		if (pInputInteractableComponent->IsActive())
+		{
+			if (pNearestActiveCandidate == nullptr || candidate.fDistance < pNearestActiveCandidate->fDistance)
+			{
+				pNearestActiveCandidate = &candidate;
+			}
+
+			if (pInputInteractableComponent == pCurrentComponent)
+			{
+				pCurrentCandidate = &candidate;
+			}
+		}
+	}
+
+	// Keep the current target unless another one gets closer by the switch margin
+	const FDropletInteractableCandidate* pSelectedCandidate = pNearestActiveCandidate;
+	if (pCurrentCandidate != nullptr && pNearestActiveCandidate != nullptr &&
+		pNearestActiveCandidate->fDistance > pCurrentCandidate->fDistance - m_fInteractableTargetSwitchMargin)
+	{
+		pSelectedCandidate = pCurrentCandidate;
+	}
+
+	m_pSelectedInteractable = pSelectedCandidate != nullptr ? pSelectedCandidate->pInteractableComponent : nullptr;
+	m_pNearestInteractable = pNearestCandidate != nullptr ? pNearestCandidate->pInteractableComponent : nullptr;
+}
+
+void ADropletPlayerCharacter::OnInteractableRangeBeginOverlap(UPrimitiveComponent* pOverlappedComponent, AActor* pOtherActor, UPrimitiveComponent* pOtherComponent, int32 iOtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+{
+	AddInteractableCandidate(pOtherActor);
+}
+
+void ADropletPlayerCharacter::OnInteractableRangeEndOverlap(UPrimitiveComponent* pOverlappedComponent, AActor* pOtherActor, UPrimitiveComponent* pOtherComponent, int32 iOtherBodyIndex)
+{
+	// The actor leaves the range only when none of its components overlap anymore
+	if (pOtherActor == nullptr || (pInteractableRangeSphereComponent != nullptr && pInteractableRangeSphereComponent->IsOverlappingActor(pOtherActor)))
+	{
+		return;
+	}
+
+	m_InteractableCandidates.RemoveAllSwap([pOtherActor](const FDropletInteractableCandidate& candidate)
+		{ return candidate.pActor.Get() == pOtherActor; });
+}
+
+void ADropletPlayerCharacter::AddInteractableCandidate(AActor* pActor)
+{
+	// Ignore itself and the actors already tracked
+	if (pActor == nullptr || pActor == this ||
+		m_InteractableCandidates.ContainsByPredicate([pActor](const FDropletInteractableCandidate& candidate) { return candidate.pActor.Get() == pActor; }))
+	{
+		return;
+	}
+
+	// Only track the actors we can interact with, resolving their components once
+	UInputInteractableActorComponent* pInputInteractableComponent = pActor->FindComponentByClass<UInputInteractableActorComponent>();
+	if (pInputInteractableComponent == nullptr)
+	{
+		return;
+	}
+
+	FDropletInteractableCandidate& candidate = m_InteractableCandidates.AddDefaulted_GetRef();
+	candidate.pActor = pActor;
+	candidate.pInteractableComponent = pInputInteractableComponent;
+}
+
+void ADropletPlayerCharacter::PruneInteractableCandidates()
+{
+	m_InteractableCandidates.RemoveAllSwap([](const FDropletInteractableCandidate& candidate)
+		{ return !candidate.pActor.IsValid() || !candidate.pInteractableComponent.IsValid(); });
+}
+
+bool ADropletPlayerCharacter::IsInteractableCandidateRootOverlapping(const FDropletInteractableCandidate& candidate) const
+{
+	AActor* pActor = candidate.pActor.Get();
+	UPrimitiveComponent* pRootComponent = pActor != nullptr ? Cast<UPrimitiveComponent>(pActor->GetRootComponent()) : nullptr;
+
+	return pRootComponent != nullptr && pInteractableRangeSphereComponent->IsOverlappingComponent(pRootComponent);
+}
+
+void ADropletPlayerCharacter::ChangeMaterialState(const FInputActionValue& Value)
+{
+	//If the controller is NOT valid or a replay drives the character, return
+	if (!m_pDropletPlayerController || IsInputOverriddenByReplay())
+	{
+		return;
+	}
+
+	if (Value.IsNonZero())
+	{
+		FVector VectorValue = Value.Get<FVector>();
+
+		if (m_pReplayRecorder.IsValid())
+		{
+			m_pReplayRecorder->RecordChangeMaterialState(VectorValue.X > 0);
+		}
+
+		//Change the material state
+		m_pDropletPlayerController->PlayerChangeMaterialState(VectorValue.X > 0 ? false : true);
+	}
+}
+
+void ADropletPlayerCharacter::PossessedBy(AController* pNewController)
+{
+	Super::PossessedBy(pNewController);
+
+	//If the controller is a ADropletPlayerController
+	if (ADropletPlayerController* castedController = CastChecked<ADropletPlayerController>(pNewController))
+	{
+		m_pDropletPlayerController = castedController;
+
+		//If the local player is valid
+		if (ULocalPlayer* localPlayer = m_pDropletPlayerController->GetLocalPlayer())
+		{
+			// Resolve the subsystem once instead of on every state change
+			m_pEnhancedInputSubsystem = ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(localPlayer);
+		}
+
+		if (m_pEnhancedInputSubsystem.IsValid())
+		{
+			// Register the current state's context, dropping the ones of the state we were in with a previous controller
+			ChangeInputMappingContext(m_pDropletPlayerController->GetMaterialState());
+		}
+		else
+		{
+			UE_LOG(LogMaterialStateMachine, Error, TEXT("ADropletPlayerCharacter::PossessedBy: the EnhancedInputLocalPlayerSubsystem is nullptr"));
+		}
+	}
+}
+
+void ADropletPlayerCharacter::Splash(const FHitResult& Hit)
+{
+	FVector vHitNormal = Hit.ImpactNormal;
+
+	// If the CharacterMovementComponent is valid
+	TObjectPtr<UCharacterMovementComponent> pCharacterMovement = GetCharacterMovement();
+	if (pCharacterMovement != nullptr)
+	{
+		// Get the angle between the hit normal and the character velocity
+		float fAngle = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(vHitNormal, -pCharacterMovement->Velocity.GetSafeNormal())));
+
+		// Get the character direction
+		FVector vCharacterDirection = pCharacterMovement->Velocity;
+		// Remove the Z coordinate
+		vCharacterDirection.Z = 0.f;
+
+		// Get the angle between the character direction and the hit normal
+		float fAngleBetweenCharacterDirectionAndHitNormal = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(vHitNormal, vCharacterDirection.GetSafeNormal())));
+
+		// Compute the splash direction to which the character will be boosted
+		m_vSplashDirection = vCharacterDirection.RotateAngleAxis(90.f - fAngleBetweenCharacterDirectionAndHitNormal, FVector::UpVector.Cross(vCharacterDirection).GetSafeNormal());
+		m_vSplashDirection = m_vSplashDirection.GetSafeNormal();
+
+		if (m_bIsSplashDebugDrawLineEnabled)
+		{
+			// Draw a debug line to show the splash direction
+			DrawDebugLine(GetWorld(), GetActorLocation(), GetActorLocation() + m_vSplashDirection * 100.f, FColor::Green, false, 3.f, 0, 12.333f);
+			DrawDebugLine(GetWorld(), GetActorLocation(), GetActorLocation() + vCharacterDirection * 100.f, FColor::Blue, false, 3.f, 0, 12.333f);
+			DrawDebugLine(GetWorld(), GetActorLocation(), GetActorLocation() + FVector::UpVector.Cross(vCharacterDirection) * 1000.f, FColor::Purple, false, 3.f, 0, 12.333f);
+		}
+
+		// If the SpeedComponent is valid
+		if (m_pSpeedComponent != nullptr)
+		{
+			bool bIsAscending = m_vSplashDirection.Z > 0.f;
+
+			// If the angle is within the the failure range or we are ascending
+			if (fAngle < 90.f - m_pSpeedComponent->m_fSplashAngleFailureThreshold || bIsAscending)
+			{
+				m_fSplashTargetSpeed = pCharacterMovement->Velocity.Size() - pCharacterMovement->Velocity.Size() * m_pSpeedComponent->m_fSplashSpeedBoostFactor;
+
+				m_bIsSplashing = true;
+
+				if (m_pSpeedComponent->m_bAreDebugMessagesEnabled)
+				{
+					GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, FString::Printf(TEXT("Splash angle: %f"), 90.f - fAngle));
+					GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, FString::Printf(TEXT("Splash speed boost: %f"), m_fSplashTargetSpeed));
+				}
+			}
+			// Else if the angle is within the success range
+			else if (fAngle >= 90.f - m_pSpeedComponent->m_fSplashAngleSuccessThreshold)
+			{
+				m_fSplashStartSpeed = pCharacterMovement->Velocity.Size();
+				m_fSplashTargetSpeed = pCharacterMovement->Velocity.Size() + pCharacterMovement->Velocity.Size() * m_pSpeedComponent->m_fSplashSpeedBoostFactor;
+
+				m_bIsSplashing = true;
+
+				if (m_pSpeedComponent->m_bAreDebugMessagesEnabled)
+				{
+					GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Green, FString::Printf(TEXT("Splash angle: %f"), 90.f - fAngle));
+					GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Green, FString::Printf(TEXT("Splash speed boost: %f"), m_fSplashTargetSpeed));
+				}
+			}
+			else if (m_pSpeedComponent->m_bAreDebugMessagesEnabled)
+			{
+				GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Yellow, FString::Printf(TEXT("Splash angle: %f"), 90.f - fAngle));
+			}
+
+			// If the splash started, let the DropletCharacterMovementComponent simulate it in its splash mode
+			if (m_bIsSplashing)
+			{
+				if (UDropletCharacterMovementComponent* pDropletMovementComponent = Cast<UDropletCharacterMovementComponent>(pCharacterMovement))
+				{
+					pDropletMovementComponent->StartSplash();
+				}
+			}
+		}
+	}
+}
+
+bool ADropletPlayerCharacter::ComputeSplashVelocity(float fDeltaTime, FVector& vOutVelocity)
+{
+	// If we are not splashing or have no speed values, return
+	if (!m_bIsSplashing || m_pSpeedComponent == nullptr)
+	{
+		return false;
+	}
+
+	// If the splash is over, end it
+	if (m_fSplashElapsedTime >= m_pSpeedComponent->m_fSplashDuration)
+	{
+		EndSplash();
+		return false;
+	}
+
+	float fCurveValue = m_SplashSpeedBoostCurve.Evaluate(m_fSplashElapsedTime / m_pSpeedComponent->m_fSplashDuration);
+
+	vOutVelocity = m_vSplashDirection * fCurveValue * m_fSplashTargetSpeed;
+
+	m_fSplashElapsedTime += fDeltaTime;
+
+	return true;
+}
+
+void ADropletPlayerCharacter::EndSplash()
+{
+	m_bIsSplashing = false;
+	m_fSplashElapsedTime = 0.f;
+}
+
+bool ADropletPlayerCharacter::ComputeSlideDashVelocity(float fDeltaTime, const FVector& vCurrentVelocity, FVector& vOutVelocity)
+{
+	// If we are not slide dashing or have no speed values, return
+	if (!m_bIsSlideDashing || m_pSpeedComponent == nullptr)
+	{
+		return false;
+	}
+
+	// If the slide dash is over, end it
+	if (m_fTransitionSpeedBoostElapsedTime >= m_pSpeedComponent->m_fLiquidToSolidSpeedBoostDuration)
+	{
+		m_bIsSlideDashing = false;
+		m_fTransitionSpeedBoostElapsedTime = 0.f;
+		return false;
+	}
+
+	float fCurveValue = m_LiquidToSolidSpeedBoostCurve.Evaluate(m_fTransitionSpeedBoostElapsedTime / m_pSpeedComponent->m_fLiquidToSolidSpeedBoostDuration);
+
+	vOutVelocity = m_vTransitionSpeedBoostStartVelocity + vCurrentVelocity.GetSafeNormal() * fCurveValue * m_fTransitionSpeedBoostTarget;
+
+	m_fTransitionSpeedBoostElapsedTime += fDeltaTime;
+
+	return true;
+}
+
+float ADropletPlayerCharacter::GetMaxFallSpeed() const
+{
+	return m_pSpeedComponent != nullptr ? m_pSpeedComponent->m_fSpeedFallMax : 0.f;
+}
+
+UInputMappingContext* ADropletPlayerCharacter::GetMaterialStateMappingContext(EDropletMaterialState eMaterialState) const
+{
+	UInputMappingContext* pInputMappingContext = nullptr;
+
+	//Switch on the material state
+	switch (eMaterialState)
+	{
+		//If the material state is solid
+	case EDropletMaterialState::EDropletMaterialState_Solid:
+	{
+		//Change the input mapping context to solid
+		pInputMappingContext = SolidMappingContext;
+		break;
+	}
+	//If the material state is liquid
+	case EDropletMaterialState::EDropletMaterialState_Liquid:
+	{
+		//Change the input mapping context to liquid
+		pInputMappingContext = LiquidMappingContext;
+		break;
+	}
+	//If the material state is gas
+	case EDropletMaterialState::EDropletMaterialState_Gazeous:
+	{
+		//Change the input mapping context to gazeous
+		pInputMappingContext = GazeousMappingContext;
+		break;
+	}
+	//If the material state is none
+	default:
+	case EDropletMaterialState::EDropletMaterialState_None:
+	{
+		//Change the input mapping context to default
+		pInputMappingContext = DefaultMappingContext;
+		break;
+	}
+	}
+
+	return pInputMappingContext;
+}
+
+void ADropletPlayerCharacter::ChangeInputMappingContext(EDropletMaterialState eNewMaterialState)
+{
+	DROPLET_SCOPE(STAT_DropletChangeInputMappingContext, "Droplet::ChangeInputMappingContext");
+
+	UInputMappingContext* pInputMappingContext = GetMaterialStateMappingContext(eNewMaterialState);
+
+	UEnhancedInputLocalPlayerSubsystem* pSubsystem = m_pEnhancedInputSubsystem.Get();
+
+	//If the subsystem is not resolved yet (state set before the possession)
+	if (pSubsystem == nullptr)
+	{
+		UE_LOG(LogMaterialStateMachine, Error, TEXT("ADropletPlayerCharacter::ChangeInputMappingContext: the EnhancedInputLocalPlayerSubsystem is not resolved"));
+		return;
+	}
+
+	if (pInputMappingContext == nullptr)
+	{
+		UE_LOG(LogMaterialStateMachine, Error, TEXT("ADropletPlayerCharacter::ChangeInputMappingContext: pInputMappingContext is nullptr"));
+	}
+
+	// Exactly one of the four contexts is registered: the state's one, or the default one for the none state.
+	// The default context is removed like the state ones, so it doesn't stay active when the base class adds it again in BeginPlay or on a restart.
+	// The other contexts of the player stay registered, and a call which changes nothing doesn't rebuild the key mappings.
+	bool bIsInputMappingContextRegistered = false;
+
+	for (UInputMappingContext* pRegisteredMappingContext : { DefaultMappingContext, LiquidMappingContext, SolidMappingContext, GazeousMappingContext })
+	{
+		if (pRegisteredMappingContext == nullptr || !pSubsystem->HasMappingContext(pRegisteredMappingContext))
+		{
+			continue;
+		}
+
+		if (pRegisteredMappingContext == pInputMappingContext)
+		{
+			bIsInputMappingContextRegistered = true;
+			continue;
+		}
+
+		pSubsystem->RemoveMappingContext(pRegisteredMappingContext);
+	}
+
+	// The removal and the addition are coalesced into a single key mapping rebuild by the subsystem
+	if (pInputMappingContext != nullptr && !bIsInputMappingContextRegistered)
+	{
+		pSubsystem->AddMappingContext(pInputMappingContext, m_iMaterialStateMappingContextPriority);
+	}
+}
+
+void ADropletPlayerCharacter::PawnClientRestart()
+{
+	Super::PawnClientRestart();
+
+	//If the restart registered the default context again, go back to the current state's one only
+	if (m_pDropletPlayerController != nullptr && m_pEnhancedInputSubsystem.IsValid())
+	{
+		ChangeInputMappingContext(m_pDropletPlayerController->GetMaterialState());
+	}
+}
+
+void ADropletPlayerCharacter::ChangeSkeletalMeshInstance(EDropletMaterialState eNewMaterialState)
+{
+	DROPLET_SCOPE(STAT_DropletChangeSkeletalMeshInstance, "Droplet::ChangeSkeletalMeshInstance");
+
+	USkeletalMesh* pSKInstance = nullptr;
+
+	//Switch on the material state
+	switch (eNewMaterialState)
+	{
+		//If the material state is solid
+	case EDropletMaterialState::EDropletMaterialState_Solid:
+	{
+		//Change the material instance to solid
+		pSKInstance = ResolveMaterialStateAsset(m_SolidSKInstanceSoft);
+		break;
+	}
+	default:
+		//If the material state is none
+	case EDropletMaterialState::EDropletMaterialState_None:
+		//If the material state is liquid
+	case EDropletMaterialState::EDropletMaterialState_Liquid:
+	{
+		//Change the material instance to liquid
+		pSKInstance = ResolveMaterialStateAsset(m_LiquidSKInstanceSoft);
+		break;
+	}
+	//If the material state is gas
+	case EDropletMaterialState::EDropletMaterialState_Gazeous:
+	{
+		//Change the material instance to gazeous
+		//pSKInstance = m_pGazeousSKInstance;
+
+		//Do not change the mesh
+		//Make it invisible
+		this->GetMesh()->SetVisibility(false);
+
+		break;
+	}
+	}
+
+
+	//Return if in gazeous state
+	if (eNewMaterialState == EDropletMaterialState::EDropletMaterialState_Gazeous)
+	{
+		return;
+	}
+
+	//Change Character mesh
+	//If the mesh is valid
+	if (USkeletalMeshComponent* pMeshComponent = this->GetMesh())
+	{
+		//If the mesh instance is valid
+		if (pSKInstance != nullptr)
+		{
+			//Change the mesh
+			pMeshComponent->SetSkeletalMesh(pSKInstance);
+
+			//Make it visible
+			pMeshComponent->SetVisibility(true);
+		}
+		else
+		{
+			UE_LOG(LogMaterialStateMachine, Error, TEXT("ADropletPlayerCharacter::ChangeSkeletalMeshInstance: pSKInstance is nullptr"));
+		}
+	}
+	else
+	{
+		UE_LOG(LogMaterialStateMachine, Error, TEXT("ADropletPlayerCharacter::ChangeSkeletalMeshInstance: pMeshComponent is nullptr"));
+	}
+}
+
+void ADropletPlayerCharacter::RequestMaterialStateAssets(EDropletMaterialState eMaterialState)
+{
+	int32 iStateIndex = GetMaterialStateIndex(eMaterialState);
+
+	// If the state is none or its assets are already requested, return
+	if (iStateIndex == INDEX_NONE || m_MaterialStateAssetsHandles[iStateIndex].IsValid())
+	{
+		return;
+	}
+
+	TArray<FSoftObjectPath> assetPaths;
+
+	// Switch on the material state, the gazeous state has no mesh (the mesh is hidden)
+	switch (eMaterialState)
+	{
+	case EDropletMaterialState::EDropletMaterialState_Liquid:
+		assetPaths.Add(m_LiquidSKInstanceSoft.ToSoftObjectPath());
+		assetPaths.Add(m_LiquidMaterialInstanceSoft.ToSoftObjectPath());
+		break;
+	case EDropletMaterialState::EDropletMaterialState_Solid:
+		assetPaths.Add(m_SolidSKInstanceSoft.ToSoftObjectPath());
+		assetPaths.Add(m_SolidMaterialInstanceSoft.ToSoftObjectPath());
+		break;
+	case EDropletMaterialState::EDropletMaterialState_Gazeous:
+		assetPaths.Add(m_GazeousMaterialInstanceSoft.ToSoftObjectPath());
+		break;
+	default:
+		break;
+	}
+
+	// Only stream the assets which are set
+	assetPaths.RemoveAll([](const FSoftObjectPath& assetPath) { return assetPath.IsNull(); });
+
+	if (assetPaths.IsEmpty())
+	{
+		return;
+	}
+
+	m_MaterialStateAssetsHandles[iStateIndex] = UAssetManager::GetStreamableManager().RequestAsyncLoad(assetPaths,
+		FStreamableDelegate::CreateUObject(this, &ADropletPlayerCharacter::OnMaterialStateAssetsLoaded, eMaterialState), FStreamableManager::DefaultAsyncLoadPriority);
+}
+
+void ADropletPlayerCharacter::OnMaterialStateAssetsLoaded(EDropletMaterialState eMaterialState)
+{
+	PrewarmMaterialStateRenderResources(eMaterialState);
+}
+
+void ADropletPlayerCharacter::PrewarmMaterialStateRenderResources(EDropletMaterialState eMaterialState)
+{
+	int32 iStateIndex = GetMaterialStateIndex(eMaterialState);
+
+	// If the state is none, already prepared or the mode is disabled, return
+	if (!m_bUsePrewarmedStateTransitions || iStateIndex == INDEX_NONE || m_bIsMaterialStatePrewarmed[iStateIndex])
+	{
+		return;
+	}
+
+	USkeletalMesh* pSKInstance = nullptr;
+	UMaterialInstance* pMaterialInstance = nullptr;
+
+	// Switch on the material state, the gazeous state hides the mesh so it has nothing to draw
+	switch (eMaterialState)
+	{
+	case EDropletMaterialState::EDropletMaterialState_Liquid:
+		pSKInstance = m_LiquidSKInstanceSoft.Get();
+		pMaterialInstance = m_LiquidMaterialInstanceSoft.Get();
+		break;
+	case EDropletMaterialState::EDropletMaterialState_Solid:
+		pSKInstance = m_SolidSKInstanceSoft.Get();
+		pMaterialInstance = m_SolidMaterialInstanceSoft.Get();
+		break;
+	case EDropletMaterialState::EDropletMaterialState_Gazeous:
+		m_bIsMaterialStatePrewarmed[iStateIndex] = true;
+		return;
+	default:
+		break;
+	}
+
+	// The blended state material mode keeps the same material in every state
+	if (m_pBlendedStateMaterial != nullptr)
+	{
+		pMaterialInstance = m_pBlendedStateMaterial;
+	}
+
+	// If the assets are still streaming, OnMaterialStateAssetsLoaded will try again
+	if (pSKInstance == nullptr || pMaterialInstance == nullptr)
+	{
+		return;
+	}
+
+	// Register a hidden transient component with the state's mesh and material, its registration requests the pipeline states
+	// they need so they are compiled now rather than on the frame the character switches to them
+	USkeletalMeshComponent* pWarmUpComponent = NewObject<USkeletalMeshComponent>(this, NAME_None, RF_Transient);
+	pWarmUpComponent->SetVisibility(false);
+	pWarmUpComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	pWarmUpComponent->SetSkeletalMesh(pSKInstance);
+	pWarmUpComponent->SetMaterial(0, pMaterialInstance);
+	pWarmUpComponent->SetupAttachment(GetMesh());
+	pWarmUpComponent->RegisterComponent();
+	pWarmUpComponent->PrecachePSOs();
+
+	// Keep it registered until the precache requests completed, ReleaseMaterialStateWarmUpComponents destroys it
+	m_MaterialStateWarmUpComponents.Add(pWarmUpComponent);
+
+	m_bIsMaterialStatePrewarmed[iStateIndex] = true;
+
+	UE_LOG(LogMaterialStateMachine, Log, TEXT("ADropletPlayerCharacter::PrewarmMaterialStateRenderResources: prepared the %s render resources"), *UEnum::GetValueAsString(eMaterialState));
+}
+
+void ADropletPlayerCharacter::ReleaseMaterialStateWarmUpComponents()
+{
+	for (int32 i = m_MaterialStateWarmUpComponents.Num() - 1; i >= 0; --i)
+	{
+		USkeletalMeshComponent* pWarmUpComponent = m_MaterialStateWarmUpComponents[i];
+
+		//If the pipeline states of the component are still compiling, keep it
+		if (pWarmUpComponent != nullptr && pWarmUpComponent->IsPSOPrecaching())
+		{
+			continue;
+		}
+
+		if (pWarmUpComponent != nullptr)
+		{
+			pWarmUpComponent->DestroyComponent();
+		}
+
+		m_MaterialStateWarmUpComponents.RemoveAtSwap(i);
+	}
+}
+
+void ADropletPlayerCharacter::ApplyMaterialStateRenderChanges(EDropletMaterialState eNewMaterialState)
+{
+	USkeletalMeshComponent* pMeshComponent = this->GetMesh();
+	uint64 uiStartCycles = FPlatformTime::Cycles64();
+
+#if STATS
+	// Time the render thread between two markers enqueued around the swap, which includes any other command queued in between.
+	// Only pay for the markers when the prewarmed transitions are measured or the stats are being collected
+	TSharedPtr<uint64, ESPMode::ThreadSafe> pRenderStartCycles;
+	if (m_bUsePrewarmedStateTransitions || FThreadStats::IsCollectingData())
+	{
+		pRenderStartCycles = MakeShared<uint64, ESPMode::ThreadSafe>(0);
+		ENQUEUE_RENDER_COMMAND(DropletStateTransitionBegin)([pRenderStartCycles](FRHICommandListImmediate& RHICmdList)
+		{
+			*pRenderStartCycles = FPlatformTime::Cycles64();
+		});
+	}
+#endif
+
+	//If the prewarmed transitions are enabled and the mesh is valid
+	if (m_bUsePrewarmedStateTransitions && pMeshComponent != nullptr)
+	{
+		// The state may not have been prepared yet if its assets were released or were still streaming
+		PrewarmMaterialStateRenderResources(eNewMaterialState);
+
+		// Tear the render state down once and rebuild it once when leaving the scope,
+		// rather than once for the mesh, once for the material and once for the visibility
+		FRenderStateRecreator renderStateRecreator(pMeshComponent);
+
+		ChangeSkeletalMeshInstance(eNewMaterialState);
+
+		ChangeMeshMaterialInstance(eNewMaterialState);
+	}
+	else
+	{
+		ChangeSkeletalMeshInstance(eNewMaterialState);
+
+		ChangeMeshMaterialInstance(eNewMaterialState);
+	}
+
+#if STATS
+	if (pRenderStartCycles.IsValid())
+	{
+		ENQUEUE_RENDER_COMMAND(DropletStateTransitionEnd)([pRenderStartCycles](FRHICommandListImmediate& RHICmdList)
+		{
+			SET_FLOAT_STAT(STAT_DropletStateTransitionRenderCommandSpanMs, FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - *pRenderStartCycles));
+		});
+	}
+#endif
+
+	m_fLastStateTransitionGameThreadMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - uiStartCycles);
+	SET_FLOAT_STAT(STAT_DropletStateTransitionGameThreadMs, m_fLastStateTransitionGameThreadMs);
+
+	UE_LOG(LogMaterialStateMachine, Verbose, TEXT("ADropletPlayerCharacter::ApplyMaterialStateRenderChanges: %s swap took %.3f ms on the game thread"), *UEnum::GetValueAsString(eNewMaterialState), m_fLastStateTransitionGameThreadMs);
+}
+
+void ADropletPlayerCharacter::EnsureMaterialStateAssetsResident(EDropletMaterialState eMaterialState)
+{
+	int32 iStateIndex = GetMaterialStateIndex(eMaterialState);
+	if (iStateIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	m_eResidentMaterialState = eMaterialState;
+
+	// Request the assets if they were never requested or released under memory pressure
+	RequestMaterialStateAssets(eMaterialState);
+
+	// If the assets are still streaming, finish loading them now rather than switching to a missing mesh
+	TSharedPtr<FStreamableHandle>& pHandle = m_MaterialStateAssetsHandles[iStateIndex];
+	if (pHandle.IsValid() && pHandle->IsLoadingInProgress())
+	{
+		UE_LOG(LogMaterialStateMachine, Warning, TEXT("ADropletPlayerCharacter::EnsureMaterialStateAssetsResident: waiting for the %s assets to be streamed in"), *UEnum::GetValueAsString(eMaterialState));
+		pHandle->WaitUntilComplete();
+	}
+}
+
+void ADropletPlayerCharacter::OnMemoryTrim()
+{
+	int32 iResidentStateIndex = GetMaterialStateIndex(m_eResidentMaterialState);
+
+	// Release the streamed assets of the other states, they are streamed in again on their next switch
+	for (int i = 0; i < MaterialStateCount; ++i)
+	{
+		if (i != iResidentStateIndex && m_MaterialStateAssetsHandles[i].IsValid())
+		{
+			m_MaterialStateAssetsHandles[i]->ReleaseHandle();
+			m_MaterialStateAssetsHandles[i].Reset();
+
+			// The render resources go with the assets, prepare them again once the assets are streamed back in
+			m_bIsMaterialStatePrewarmed[i] = false;
+		}
+	}
+
+	UE_LOG(LogMaterialStateMachine, Log, TEXT("ADropletPlayerCharacter::OnMemoryTrim: released the streamed assets of the other states"));
+}
+
+void ADropletPlayerCharacter::ChangeMeshMaterialInstance(EDropletMaterialState eNewMaterialState)
+{
+	DROPLET_SCOPE(STAT_DropletChangeMeshMaterialInstance, "Droplet::ChangeMeshMaterialInstance");
+
+	// In the blended state material mode, only the parameters change
+	if (m_pBlendedStateMaterial != nullptr)
+	{
+		BeginStateMaterialBlend(eNewMaterialState);
+		return;
+	}
+
+	UMaterialInstance* pMaterialInstance = nullptr;
+
+	//Switch on the material state
+	switch (eNewMaterialState)
+	{
+		//If the material state is solid
+	case EDropletMaterialState::EDropletMaterialState_Solid:
+	{
+		//Change the material instance to solid
+		pMaterialInstance = ResolveMaterialStateAsset(m_SolidMaterialInstanceSoft);
+		break;
+	}
+	default:
+		//If the material state is none
+	case EDropletMaterialState::EDropletMaterialState_None:
+		//If the material state is liquid
+	case EDropletMaterialState::EDropletMaterialState_Liquid:
+	{
+		//Change the material instance to liquid
+		pMaterialInstance = ResolveMaterialStateAsset(m_LiquidMaterialInstanceSoft);
+		break;
+	}
+	//If the material state is gas
+	case EDropletMaterialState::EDropletMaterialState_Gazeous:
+	{
+		//Change the material instance to gazeous
+		pMaterialInstance = ResolveMaterialStateAsset(m_GazeousMaterialInstanceSoft);
+		break;
+	}
+	}
+
+	//Change Character mesh's material
+	//If the mesh is valid
+	if (USkeletalMeshComponent* pMeshComponent = this->GetMesh())
+	{
+		//If the material instance is valid
+		if (pMaterialInstance != nullptr)
+		{
+			//Change the material instance
+			pMeshComponent->SetMaterial(0, pMaterialInstance);
+		}
+		else
+		{
+			UE_LOG(LogMaterialStateMachine, Error, TEXT("ADropletPlayerCharacter::ChangeMeshMaterialInstance: pMaterialInstance is nullptr"));
+		}
+	}
+	else
+	{
+		UE_LOG(LogMaterialStateMachine, Error, TEXT("ADropletPlayerCharacter::ChangeMeshMaterialInstance: pMeshComponent is nullptr"));
+	}
+}
+
+void ADropletPlayerCharacter::CreateBlendedStateMaterial()
+{
+	// If the mode is disabled or the material is already created, return
+	if (!m_bUseBlendedStateMaterial || m_pBlendedStateMaterial != nullptr)
+	{
+		return;
+	}
+
+	if (m_pBlendedStateBaseMaterial == nullptr)
+	{
+		UE_LOG(LogMaterialStateMachine, Error, TEXT("ADropletPlayerCharacter::CreateBlendedStateMaterial: m_pBlendedStateBaseMaterial is nullptr, falling back to the material instance swaps"));
+		return;
+	}
+
+	USkeletalMeshComponent* pMeshComponent = this->GetMesh();
+	if (pMeshComponent == nullptr)
+	{
+		UE_LOG(LogMaterialStateMachine, Error, TEXT("ADropletPlayerCharacter::CreateBlendedStateMaterial: pMeshComponent is nullptr"));
+		return;
+	}
+
+	m_pBlendedStateMaterial = UMaterialInstanceDynamic::Create(m_pBlendedStateBaseMaterial, this);
+	pMeshComponent->SetMaterial(0, m_pBlendedStateMaterial);
+
+	// Start from the current state's parameters without blending, the liquid ones if no state was set yet
+	BeginStateMaterialBlend(m_eResidentMaterialState);
+	UpdateStateMaterialBlend(m_fBaseStateChangeDuration);
+}
+
+void ADropletPlayerCharacter::BeginStateMaterialBlend(EDropletMaterialState eNewMaterialState)
+{
+	//Switch on the material state
+	switch (eNewMaterialState)
+	{
+	case EDropletMaterialState::EDropletMaterialState_Solid:
+		m_pStateMaterialBlendToParameters = &m_SolidMaterialParameters;
+		break;
+	case EDropletMaterialState::EDropletMaterialState_Gazeous:
+		m_pStateMaterialBlendToParameters = &m_GazeousMaterialParameters;
+		break;
+	default:
+	case EDropletMaterialState::EDropletMaterialState_None:
+	case EDropletMaterialState::EDropletMaterialState_Liquid:
+		m_pStateMaterialBlendToParameters = &m_LiquidMaterialParameters;
+		break;
+	}
+
+	m_StateMaterialBlendFromParameters = m_StateMaterialCurrentParameters;
+	m_fStateMaterialBlendElapsedTime = 0.f;
+
+	// Without blending, push the parameters right away
+	if (!m_bBlendStateMaterialParameters || m_fBaseStateChangeDuration <= 0.f)
+	{
+		UpdateStateMaterialBlend(0.f);
+	}
+}
+
+void ADropletPlayerCharacter::UpdateStateMaterialBlend(float fDeltaTime)
+{
+	// If not blending, return
+	if (m_pBlendedStateMaterial == nullptr || m_pStateMaterialBlendToParameters == nullptr)
+	{
+		return;
+	}
+
+	m_fStateMaterialBlendElapsedTime += fDeltaTime;
+
+	float fAlpha = 1.f;
+	if (m_bBlendStateMaterialParameters && m_fBaseStateChangeDuration > 0.f)
+	{
+		fAlpha = FMath::Clamp(m_fStateMaterialBlendElapsedTime / m_fBaseStateChangeDuration, 0.f, 1.f);
+	}
+
+	// Parameters the previous state did not set start from the target value
+	for (const TPair<FName, float>& scalarParameter : m_pStateMaterialBlendToParameters->ScalarParameters)
+	{
+		const float* pFromValue = m_StateMaterialBlendFromParameters.ScalarParameters.Find(scalarParameter.Key);
+		float fValue = FMath::Lerp(pFromValue != nullptr ? *pFromValue : scalarParameter.Value, scalarParameter.Value, fAlpha);
+
+		m_pBlendedStateMaterial->SetScalarParameterValue(scalarParameter.Key, fValue);
+		m_StateMaterialCurrentParameters.ScalarParameters.Add(scalarParameter.Key, fValue);
+	}
+
+	for (const TPair<FName, FLinearColor>& vectorParameter : m_pStateMaterialBlendToParameters->VectorParameters)
+	{
+		const FLinearColor* pFromValue = m_StateMaterialBlendFromParameters.VectorParameters.Find(vectorParameter.Key);
+		FLinearColor value = FMath::Lerp(pFromValue != nullptr ? *pFromValue : vectorParameter.Value, vectorParameter.Value, fAlpha);
+
+		m_pBlendedStateMaterial->SetVectorParameterValue(vectorParameter.Key, value);
+		m_StateMaterialCurrentParameters.VectorParameters.Add(vectorParameter.Key, value);
+	}
+
+	// The blend is over
+	if (fAlpha >= 1.f)
+	{
+		m_pStateMaterialBlendToParameters = nullptr;
+	}
+}
+
+void ADropletPlayerCharacter::ChangeStaminaComponent(EDropletMaterialState eNewMaterialState)
+{
+	DROPLET_SCOPE(STAT_DropletChangeStaminaComponent, "Droplet::ChangeStaminaComponent");
+
+	int32 iStateIndex = GetMaterialStateIndex(eNewMaterialState);
+	if (iStateIndex == INDEX_NONE)
+	{
+		// Log error
+		UE_LOG(LogStamina, Error, TEXT("ADropletPlayerCharacter::ChangeStaminaComponent: eNewMaterialState is NONE!"));
+		return;
+	}
+
+	//If the state components were not created yet, create them
+	if (m_StaminaComponentPool.IsEmpty())
+	{
+		CreateStaminaComponents();
+	}
+
+	UStaminaComponent* pNewStaminaComponent = m_StaminaComponentPool[iStateIndex];
+	if (pNewStaminaComponent == nullptr)
+	{
+		UE_LOG(LogStamina, Error, TEXT("ADropletPlayerCharacter::ChangeStaminaComponent: stamina component class number %i is nullptr"), iStateIndex + 1);
+		return;
+	}
+
+	UStaminaComponent* pStaminaComponent = GetStaminaComponent();
+
+	//If the state's component is already the active one, there is nothing to hand over
+	if (pStaminaComponent == pNewStaminaComponent)
+	{
+		return;
+	}
+
+	float fStamina = 100.f;
+	bool bIsInfiniteStaminaEnabled = false;
+	bool bAreDebugMessagesEnabled = false;
+	bool bShowDebugStaminaBar = false;
+
+	// If StaminaComponent is nullptr, log warning
+	if (pStaminaComponent == nullptr)
+	{
+		UE_LOG(LogStamina, Warning, TEXT("ADropletPlayerCharacter::ChangeStaminaComponent: staminaComponent is nullptr"));
+	}
+	// Else register current stamina and debug flags, then put it back in the pool
+	else
+	{
+		fStamina = pStaminaComponent->GetCurrentStamina();
+
+		bIsInfiniteStaminaEnabled = pStaminaComponent->m_bIsInfiniteStaminaEnabled;
+		bAreDebugMessagesEnabled = pStaminaComponent->m_bAreDebugMessagesEnabled;
+		bShowDebugStaminaBar = pStaminaComponent->m_bShowDebugStaminaBar;
+
+		// A StaminaComponent which is not one of the state components (e.g. added in the Blueprint) is destroyed as before
+		if (m_StaminaComponentPool.Contains(pStaminaComponent))
+		{
+			SetStaminaComponentActive(pStaminaComponent, false);
+		}
+		else
+		{
+			pStaminaComponent->DestroyComponent();
+			m_StaminaComponentHandle.Invalidate();
+		}
+	}
+
+	SetStaminaComponentActive(pNewStaminaComponent, true);
+
+	pNewStaminaComponent->SetCurrentStamina(fStamina);
+
+	pNewStaminaComponent->m_bIsInfiniteStaminaEnabled = bIsInfiniteStaminaEnabled;
+	pNewStaminaComponent->m_bAreDebugMessagesEnabled = bAreDebugMessagesEnabled;
+	pNewStaminaComponent->m_bShowDebugStaminaBar = bShowDebugStaminaBar;
+}
+
+TSubclassOf<UStaminaComponent> ADropletPlayerCharacter::GetMaterialStateStaminaComponentClass(int32 iStateIndex) const
+{
+	const TSubclassOf<UStaminaComponent> staminaComponentClasses[MaterialStateCount] =
+	{
+		LiquidStaminaComponent,
+		SolidStaminaComponent,
+		GazeousStaminaComponent
+	};
+
+	return staminaComponentClasses[iStateIndex];
+}
+
+void ADropletPlayerCharacter::CreateStaminaComponents()
+{
+	m_StaminaComponentPool.SetNum(MaterialStateCount);
+
+	for (int32 iStateIndex = 0; iStateIndex < MaterialStateCount; ++iStateIndex)
+	{
+		const TSubclassOf<UStaminaComponent> staminaComponentClass = GetMaterialStateStaminaComponentClass(iStateIndex);
+		if (staminaComponentClass == nullptr || m_StaminaComponentPool[iStateIndex] != nullptr)
+		{
+			continue;
+		}
+
+		// Each state keeps a real instance of its own class, created and registered once
+		UStaminaComponent* pStaminaComponent = CastChecked<UStaminaComponent>(AddComponentByClass(staminaComponentClass, false, FTransform::Identity, false));
+		m_StaminaComponentPool[iStateIndex] = pStaminaComponent;
+
+		SetStaminaComponentActive(pStaminaComponent, false);
+	}
+}
+
+void ADropletPlayerCharacter::SetStaminaComponentActive(UStaminaComponent* pStaminaComponent, bool bIsActive)
+{
+	// Only the active component is owned by the character, so FindComponentByClass and GetComponents only see the current state's one
+	if (bIsActive)
+	{
+		AddOwnedComponent(pStaminaComponent);
+		pStaminaComponent->Activate(true);
+	}
+	else
+	{
+		pStaminaComponent->Deactivate();
+		RemoveOwnedComponent(pStaminaComponent);
+	}
+
+	m_StaminaComponentHandle.Invalidate();
+}
+
+UStaminaComponent* ADropletPlayerCharacter::GetStaminaComponent() const
+{
+	// Resolve the stamina component only after it was created
+	if (!m_StaminaComponentHandle.IsResolved())
+	{
+		m_StaminaComponentHandle.Set(FindComponentByClass<UStaminaComponent>());
+	}
+
+	return m_StaminaComponentHandle.Get();
+}
+
+void ADropletPlayerCharacter::VerifyComponentHandles() const
+{
+	// A mismatch means a component was swapped without invalidating its handle
+	ensureMsgf(!m_StaminaComponentHandle.IsResolved() || m_StaminaComponentHandle.Get() == FindComponentByClass<UStaminaComponent>(),
+		TEXT("ADropletPlayerCharacter::VerifyComponentHandles: cached stamina component doesn't match the owned one"));
+	ensureMsgf(m_pSpeedComponent == nullptr || m_pSpeedComponent == FindComponentByClass<USpeedComponent>(),
+		TEXT("ADropletPlayerCharacter::VerifyComponentHandles: cached speed component doesn't match the owned one"));
+}
+
+int32 ADropletPlayerCharacter::GetMaterialStateIndex(EDropletMaterialState eMaterialState)
+{
+	switch (eMaterialState)
+	{
+	case EDropletMaterialState::EDropletMaterialState_Liquid:
+		return 0;
+	case EDropletMaterialState::EDropletMaterialState_Solid:
+		return 1;
+	case EDropletMaterialState::EDropletMaterialState_Gazeous:
+		return 2;
+	default:
+	case EDropletMaterialState::EDropletMaterialState_None:
+		return INDEX_NONE;
+	}
+}
+
+void ADropletPlayerCharacter::ApplySpeedComponentStateValues(EDropletMaterialState eNewMaterialState)
+{
+	// Resolve the cached SpeedComponent if one is already owned
+	if (m_pSpeedComponent == nullptr)
+	{
+		m_pSpeedComponent = FindComponentByClass<USpeedComponent>();
+	}
+
+	// If SpeedComponent is nullptr, add it
+	if (m_pSpeedComponent == nullptr)
+	{
+		m_pSpeedComponent = CastChecked<USpeedComponent>(AddComponentByClass(SpeedComponent, false, FTransform::Identity, false));
+		UE_LOG(LogSpeed, Warning, TEXT("ADropletPlayerCharacter::ApplySpeedComponentStateValues: SpeedComponent added"));
+	}
+
+	// Bake the speed curves of the SpeedComponent the first time it is resolved
+	BakeSpeedCurves();
+
+	// Gather the per state values now that the SpeedComponent is resolved, the Tick reads them from the current state's record
+	BuildMaterialStateRecords();
+	m_iCurrentMaterialStateIndex = GetMaterialStateIndex(eNewMaterialState);
+
+	const FDropletMaterialStateRecord& stateRecord = GetCurrentMaterialStateRecord();
+	UCharacterMovementComponent* pCharacterMovement = GetCharacterMovement();
+
+	// Switch on the material state to apply the correct values
+	switch (eNewMaterialState)
+	{
+	case EDropletMaterialState::EDropletMaterialState_Liquid:
+		pCharacterMovement->MaxWalkSpeed = stateRecord.fMaxFlatSpeed;
+		pCharacterMovement->MaxAcceleration = stateRecord.fMaxAcceleration;
+		break;
+	case EDropletMaterialState::EDropletMaterialState_Solid:
+		pCharacterMovement->MaxWalkSpeed = stateRecord.fMaxFlatSpeed;
+		pCharacterMovement->MaxAcceleration = stateRecord.fMaxAcceleration;
+		m_bIsSlideDashing = true;
+
+		// Drop the time left over by a previous slide dash which ended in the air
+		if (UDropletCharacterMovementComponent* pDropletMovementComponent = Cast<UDropletCharacterMovementComponent>(pCharacterMovement))
+		{
+			pDropletMovementComponent->StartSlideDash();
+		}
+		break;
+	case EDropletMaterialState::EDropletMaterialState_Gazeous:
+		pCharacterMovement->MaxFlySpeed = stateRecord.fMaxFlySpeed;
+		pCharacterMovement->MaxAcceleration = stateRecord.fMaxAcceleration;
+		m_bIsGazeousDashing = true;
+		break;
+	default:
+	case EDropletMaterialState::EDropletMaterialState_None:
+		// Log error
+		UE_LOG(LogSpeed, Error, TEXT("ADropletPlayerCharacter::ApplySpeedComponentStateValues: eNewMaterialState is NONE!"));
+		break;
+	}
+
+	// If the character is on the ground and is in slide dash
+	if (m_bIsSlideDashing && pCharacterMovement->IsMovingOnGround())
+	{
+		// Prepare the slide dash values
+
+		m_vTransitionSpeedBoostStartVelocity = pCharacterMovement->Velocity.Length() <= m_fVelocityMovingTolerance ?
+			GetCapsuleComponent()->GetForwardVector() * m_pSpeedComponent->m_fLiquidToSolidSpeedBoostImpulseFactorNoMovement :
+			pCharacterMovement->Velocity;
+
+		m_fTransitionSpeedBoostTarget = pCharacterMovement->Velocity.Length() + pCharacterMovement->Velocity.Length() * 0.5f;
+		m_fTransitionSpeedBoostElapsedTime = 0.f;
+
+		// Add Breaker marker
+		m_bIsSlideDashBreaking = true;
+		AddInteractableMarker<UBreakerInteractableMarker>();
+	}
+	// Else if the character is in gazeous dash
+	else if (m_bIsGazeousDashing)
+	{
+		// Do the gazeous dash
+		pCharacterMovement->AddImpulse(
+			FVector::UpVector * (pCharacterMovement->IsMovingOnGround() ? m_pSpeedComponent->m_fLiquidToGazeousSpeedBoostImpulseFactor :
+				pCharacterMovement->Velocity.Z < 0.f ? m_pSpeedComponent->m_fLiquidToGazeousSpeedBoostImpulseFactor * 3 :
+				m_pSpeedComponent->m_fLiquidToGazeousSpeedBoostImpulseFactor)
+		);
+		m_bIsGazeousDashing = false;
+	}
+	// Else cancel the slide dash
+	else
+	{
+		m_bIsSlideDashing = false;
+	}
+}
+
+void ADropletPlayerCharacter::ApplyMaterialStateDurationAndCooldown(EDropletMaterialState eNewMaterialState)
+{
+	int32 iStateIndex = GetMaterialStateIndex(eNewMaterialState);
+
+	// The liquid and none states don't last a limited time
+	if (iStateIndex == INDEX_NONE || !m_MaterialStateRecords[iStateIndex].bHasStateDuration)
+	{
+		return;
+	}
+
+	m_fCurrentStateDuration = m_MaterialStateRecords[iStateIndex].fStateDuration;
+	m_fCurrentStateChangeCooldown = m_MaterialStateRecords[iStateIndex].fStateCooldown;
+}
+
+bool FDropletBakedCurve::Bake(const UCurveFloat* pCurve)
+{
+	// If this curve is already baked, return
+	if (bIsBaked && pSourceCurve.Get() == pCurve)
+	{
+		return false;
+	}
+
+	pSourceCurve = pCurve;
+	bIsBaked = pCurve != nullptr;
+
+	for (int i = 0; i <= IntervalCount; ++i)
+	{
+		Samples[i] = pCurve != nullptr ? pCurve->GetFloatValue(static_cast<float>(i) / IntervalCount) : 0.f;
+	}
+
+	return true;
+}
+
+float FDropletBakedCurve::ComputeMaxError(int32 iCheckCount) const
+{
+	const UCurveFloat* pCurve = pSourceCurve.Get();
+	if (pCurve == nullptr || iCheckCount <= 0)
+	{
+		return 0.f;
+	}
+
+	float fMaxError = 0.f;
+	for (int i = 0; i <= iCheckCount; ++i)
+	{
+		float fTime = static_cast<float>(i) / iCheckCount;
+		fMaxError = FMath::Max(fMaxError, FMath::Abs(Evaluate(fTime) - pCurve->GetFloatValue(fTime)));
+	}
+
+	return fMaxError;
+}
+
+void ADropletPlayerCharacter::BakeSpeedCurves()
+{
+	// If the SpeedComponent is NOT valid, return
+	if (m_pSpeedComponent == nullptr)
+	{
+		return;
+	}
+
+	// Only the curves which changed since the last bake are sampled again
+	bool bHasBakedSplash = m_SplashSpeedBoostCurve.Bake(m_pSpeedComponent->m_fCurveSplashSpeedBoost);
+	bool bHasBakedLiquidToSolid = m_LiquidToSolidSpeedBoostCurve.Bake(m_pSpeedComponent->m_fCurveLiquidToSolidSpeedBoost);
+
+	if ((bHasBakedSplash && !m_SplashSpeedBoostCurve.bIsBaked) || (bHasBakedLiquidToSolid && !m_LiquidToSolidSpeedBoostCurve.bIsBaked))
+	{
+		UE_LOG(LogSpeed, Error, TEXT("ADropletPlayerCharacter::BakeSpeedCurves: a speed boost curve of the SpeedComponent is nullptr"));
+	}
+
+#if WITH_EDITOR
+	// Report how far the lookup tables are from the curves the designers authored
+	const int32 iCheckCount = FDropletBakedCurve::IntervalCount * 16;
+
+	if (bHasBakedSplash && m_SplashSpeedBoostCurve.bIsBaked)
+	{
+		UE_LOG(LogSpeed, Log, TEXT("ADropletPlayerCharacter::BakeSpeedCurves: splash speed boost curve baked, max error %f"), m_SplashSpeedBoostCurve.ComputeMaxError(iCheckCount));
+	}
+
+	if (bHasBakedLiquidToSolid && m_LiquidToSolidSpeedBoostCurve.bIsBaked)
+	{
+		UE_LOG(LogSpeed, Log, TEXT("ADropletPlayerCharacter::BakeSpeedCurves: liquid to solid speed boost curve baked, max error %f"), m_LiquidToSolidSpeedBoostCurve.ComputeMaxError(iCheckCount));
+	}
+#endif
+}
+
+void ADropletPlayerCharacter::BuildMaterialStateRecords()
+{
+	// Liquid
+	FDropletMaterialStateRecord& liquidRecord = m_MaterialStateRecords[GetMaterialStateIndex(EDropletMaterialState::EDropletMaterialState_Liquid)];
+	liquidRecord = FDropletMaterialStateRecord();
+	liquidRecord.bIsSlowedDownByEmptyStamina = true;
+
+	// Solid
+	FDropletMaterialStateRecord& solidRecord = m_MaterialStateRecords[GetMaterialStateIndex(EDropletMaterialState::EDropletMaterialState_Solid)];
+	solidRecord = FDropletMaterialStateRecord();
+	solidRecord.bHasStateDuration = true;
+	solidRecord.fStateDuration = m_fSolidStateDuration;
+	solidRecord.fStateCooldown = m_fSolidStateCooldown;
+
+	// Gazeous, the governor keeps MaxWalkSpeed as is
+	FDropletMaterialStateRecord& gazeousRecord = m_MaterialStateRecords[GetMaterialStateIndex(EDropletMaterialState::EDropletMaterialState_Gazeous)];
+	gazeousRecord = FDropletMaterialStateRecord();
+	gazeousRecord.bHasStateDuration = true;
+	gazeousRecord.fStateDuration = m_fGazeousStateDuration;
+	gazeousRecord.fStateCooldown = m_fGazeousStateCooldown;
+
+	// If the SpeedComponent is NOT valid, the states have no speeds to apply
+	if (m_pSpeedComponent == nullptr)
+	{
+		UE_LOG(LogSpeed, Warning, TEXT("ADropletPlayerCharacter::BuildMaterialStateRecords: m_pSpeedComponent is nullptr"));
+		return;
+	}
+
+	liquidRecord.bHasGroundSpeeds = true;
+	liquidRecord.fMaxAscendingSpeed = m_pSpeedComponent->GetSpeedAscendingMaxLiquid();
+	liquidRecord.fMinAscendingSpeed = m_pSpeedComponent->GetSpeedAscendingMinLiquid();
+	liquidRecord.fMaxDescendingSpeed = m_pSpeedComponent->GetSpeedDescendingMaxLiquid();
+	liquidRecord.fMaxFlatSpeed = m_pSpeedComponent->m_fSpeedFlatMaxLiquid;
+	liquidRecord.fAscendingFactor = m_pSpeedComponent->m_fAscendingFactorLiquid;
+	liquidRecord.fAscendingFactorEmptyStamina = m_pSpeedComponent->m_fAscendingFactorLiquidEmptyStamina;
+	liquidRecord.fDescendingFactor = m_pSpeedComponent->m_fDescendingFactorLiquid;
+	liquidRecord.fMaxAcceleration = m_pSpeedComponent->m_fAccelerationFlatLiquid;
+
+	solidRecord.bHasGroundSpeeds = true;
+	solidRecord.fMaxAscendingSpeed = m_pSpeedComponent->GetSpeedAscendingMaxSolid();
+	solidRecord.fMaxDescendingSpeed = m_pSpeedComponent->GetSpeedDescendingMaxSolid();
+	solidRecord.fMaxFlatSpeed = m_pSpeedComponent->m_fSpeedFlatMaxSolid;
+	solidRecord.fAscendingFactor = m_pSpeedComponent->m_fAscendingFactorSolid;
+	solidRecord.fDescendingFactor = m_pSpeedComponent->m_fDescendingFactorSolid;
+	solidRecord.fMaxAcceleration = m_pSpeedComponent->m_fAccelerationFlatSolid;
+
+	gazeousRecord.fMaxFlySpeed = m_pSpeedComponent->m_fSpeedMaxGazeous;
+	gazeousRecord.fMaxAcceleration = m_pSpeedComponent->m_fAccelerationGazeous;
+}
+
+const FDropletMaterialStateRecord& ADropletPlayerCharacter::GetCurrentMaterialStateRecord() const
+{
+	// Record of the none state, nothing to apply
+	static const FDropletMaterialStateRecord noneRecord;
+
+	return m_iCurrentMaterialStateIndex != INDEX_NONE ? m_MaterialStateRecords[m_iCurrentMaterialStateIndex] : noneRecord;
+}
+
+float ADropletPlayerCharacter::GetSlopeAngle(FHitResult& Hit, FVector& vGlobalSlopeNormal) const
+{
+	DROPLET_SCOPE(STAT_DropletGetSlopeAngle, "Droplet::GetSlopeAngle");
+	DROPLET_BENCHMARK_SCOPE(EDropletBenchmarkSection_GetSlopeAngle);
+
+	// Get the probe ring results of this frame
+	const FDropletGroundProbe& groundProbe = GetGroundProbe();
+
+	// Give back the last sample of the probe as the hit result
+	Hit = groundProbe.iSampleCount > 0 ? groundProbe.Hits[groundProbe.iSampleCount - 1] : FHitResult();
+	vGlobalSlopeNormal = groundProbe.vGlobalSlopeNormal;
+
+	return groundProbe.fSlopeAngle;
+}
+
+bool ADropletPlayerCharacter::IsAscending() const
+{
+	DROPLET_SCOPE(STAT_DropletIsAscending, "Droplet::IsAscending");
+
+	// Check if we are NOT moving
+	if (GetCharacterMovement()->Velocity.Size() <= m_fVelocityMovingTolerance)
+	{
+		return false;
+	}
+
+	bool bAscending = false;
+
+	// Get the probe ring results of this frame
+	const FDropletGroundProbe& groundProbe = GetGroundProbe();
+	FVector vVelocityDirection = GetCharacterMovement()->Velocity.GetSafeNormal();
+
+	for (int i = 0; i < groundProbe.iSampleCount; ++i)
+	{
+		if (groundProbe.bHasHit[i])
+		{
+			float fAngle = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(groundProbe.Hits[i].ImpactNormal, vVelocityDirection)));
+
+			bAscending = bAscending || fAngle > 90.f;
+		}
+	}
+
+	return bAscending;
+}
+
+bool ADropletPlayerCharacter::IsOnFlat() const
+{
+	FHitResult hit;
+	FVector vHitNormal;
+	float fSlopeAngle = GetSlopeAngle(hit, vHitNormal);
+
+	return fSlopeAngle <= m_fFlatSurfaceTolerance;
+}
+
+void ADropletPlayerCharacter::Landed(const FHitResult& Hit)
+{
+	Super::Landed(Hit);
+
+	// The ground probe cached before the fall doesn't describe the landing ground
+	InvalidateGroundProbeCache();
+
+	// If the DropletPlayerController is not valid return
+	if (m_pDropletPlayerController == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("ADropletPlayerCharacter::Landed: m_pDropletPlayerController is nullptr"));
+		return;
+	}
+
+	// If the material state is liquid
+	if (m_pDropletPlayerController->GetMaterialState() == EDropletMaterialState::EDropletMaterialState_Liquid)
+	{
+		// If the character is not splashing and can splash
+		if (!m_bIsSplashing && m_bCanSplash)
+		{
+			Splash(Hit);
+		}
+
+		BPE_OnLanded(EDropletMaterialState::EDropletMaterialState_Liquid);
+
+		m_bCanSplash = false;
+	}
+	// Else if the material state is solid
+	else if (m_pDropletPlayerController->GetMaterialState() == EDropletMaterialState::EDropletMaterialState_Solid)
+	{
+		BPE_OnLanded(EDropletMaterialState::EDropletMaterialState_Solid);
+	}
+}
+
+void ADropletPlayerCharacter::TeleportSucceeded(bool bIsATest)
+{
+	Super::TeleportSucceeded(bIsATest);
+
+	if (bIsATest)
+	{
+		return;
+	}
+
+	// The probes traced before the teleport don't describe the new ground anymore
+	InvalidateGroundProbeCache();
+	m_uiAsyncGroundProbeSubmitFrame = MAX_uint64;
+}
+
+#pragma region InterctableMarkers
+TArray<UInteractableMarker*> ADropletPlayerCharacter::GetInteractableMarkers() const
+{
+	return m_InteractableMarkers;
+}
+
+template <typename T>
+UInteractableMarker* ADropletPlayerCharacter::GetPooledInteractableMarker()
+{
+	if (m_InteractableMarkerPool.Num() < InteractableMarkerTypeCount)
+	{
+		m_InteractableMarkerPool.SetNum(InteractableMarkerTypeCount);
+	}
+
+	// Create the marker of this type only the first time it is needed
+	TObjectPtr<UInteractableMarker>& pInteractableMarker = m_InteractableMarkerPool[TDropletInteractableMarkerBit<T>::Index];
+	if (pInteractableMarker == nullptr)
+	{
+		pInteractableMarker = NewObject<T>(this);
+	}
+
+	return pInteractableMarker;
+}
+
+template <typename T>
+void ADropletPlayerCharacter::AddInteractableMarker()
+{
+	constexpr uint8 uiMarkerBit = 1 << TDropletInteractableMarkerBit<T>::Index;
+
+	RefreshInteractableMarkerMask();
+
+	// If the interactable marker is not already in the array
+	if ((m_uiInteractableMarkerMask & uiMarkerBit) == 0)
+	{
+		m_uiInteractableMarkerMask |= uiMarkerBit;
+
+		// Add the pooled interactable marker to the array
+		m_InteractableMarkers.Add(GetPooledInteractableMarker<T>());
+
+		// Log the interactable marker is added
+		UE_LOG(LogInteractable, Warning, TEXT("ADropletPlayerCharacter::AddInteractableMarker: Added %s"), *m_InteractableMarkers.Last()->GetName());
+	}
+}
+
+template <typename T>
+void ADropletPlayerCharacter::RemoveInteractableMarker()
+{
+	constexpr uint8 uiMarkerBit = 1 << TDropletInteractableMarkerBit<T>::Index;
+
+	RefreshInteractableMarkerMask();
+
+	// If the interactable marker is not in the array
+	if ((m_uiInteractableMarkerMask & uiMarkerBit) == 0)
+	{
+		return;
+	}
+
+	m_uiInteractableMarkerMask &= ~uiMarkerBit;
+
+	// Remove the pooled marker and any marker of this type a Blueprint added
+	m_InteractableMarkers.RemoveAll([](const UInteractableMarker* pInteractableMarker) { return pInteractableMarker != nullptr && pInteractableMarker->IsA<T>(); });
+}
+
+template <typename T>
+bool ADropletPlayerCharacter::HasInteractableMarker() const
+{
+	RefreshInteractableMarkerMask();
+
+	return (m_uiInteractableMarkerMask & (1 << TDropletInteractableMarkerBit<T>::Index)) != 0;
+}
+
+bool ADropletPlayerCharacter::BPF_HasBreakerMarker() const
+{
+	return HasInteractableMarker<UBreakerInteractableMarker>();
+}
+
+bool ADropletPlayerCharacter::BPF_HasDrillerMarker() const
+{
+	return HasInteractableMarker<UDrillerInteractableMarker>();
+}
+
+void ADropletPlayerCharacter::ClearInteractableMarkers()
+{
+	m_InteractableMarkers.Reset();
+	m_uiInteractableMarkerMask = 0;
+}
+
+void ADropletPlayerCharacter::RefreshInteractableMarkerMask() const
+{
+	// The array holds at most one marker per type, so this only tests a couple of classes
+	uint8 uiMarkerMask = 0;
+	for (const UInteractableMarker* pInteractableMarker : m_InteractableMarkers)
+	{
+		uiMarkerMask |= FDropletInteractableMarkerTypes::GetTypeMask(pInteractableMarker);
+	}
+
+	m_uiInteractableMarkerMask = uiMarkerMask;
+}
+#pragma endregion
+
+const FDropletGroundProbe& ADropletPlayerCharacter::GetGroundProbe() const
+{
+	// Fire the probe ring only once per frame, the following queries reuse its results
+	if (m_GroundProbe.uiFrameNumber != GFrameCounter)
+	{
+		// Reuse the previous ring if we didn't move much on the same static ground
+		if (IsGroundProbeCacheValid())
+		{
+			m_GroundProbe.uiFrameNumber = GFrameCounter;
+			m_uiGroundProbeCacheHits++;
+		}
+		else
+		{
+			UpdateGroundProbe();
+			StoreGroundProbeCache();
+
+			if (m_bUseGroundProbeCache)
+			{
+				m_uiGroundProbeCacheMisses++;
+			}
+		}
 	}
+
+	return m_GroundProbe;
 }
 
-void ADropletPlayerCharacter::ChangeStaminaComponent(EDropletMaterialState eNewMaterialState)
+void ADropletPlayerCharacter::UpdateGroundProbe() const
 {
-	UStaminaComponent* pStaminaComponent = Cast<UStaminaComponent>(GetComponentByClass(UStaminaComponent::StaticClass()));
-	UStaminaComponent* pNewStaminaComponent = nullptr;
+	uint64 uiStartCycles = FPlatformTime::Cycles64();
 
-	float fStamina = 100.f;
-	bool bIsInfiniteStaminaEnabled = false;
-	bool bAreDebugMessagesEnabled = false;
-	bool bShowDebugStaminaBar = false;
+	FillGroundProbe(m_GroundProbe, m_eGroundSensingMode, true);
+	VoteGroundProbe(m_GroundProbe, m_bSlopeDetectionDebugDrawLineEnabled);
+	m_GroundProbe.uiFrameNumber = GFrameCounter;
 
-	// If StaminaComponent is nullptr, log error
-	if (pStaminaComponent == nullptr)
+	RecordGroundSensingCost(m_eGroundSensingMode, FPlatformTime::Cycles64() - uiStartCycles);
+
+	// Also run the other ground sensing mode to measure how far apart they are
+	if (m_bCompareGroundSensingModes)
 	{
-		UE_LOG(LogStamina, Warning, TEXT("ADropletPlayerCharacter::ChangeStaminaComponent: staminaComponent is nullptr"));
+		CompareGroundSensingModes();
 	}
-	// If StaminaComponent is not nullptr, register current stamina and debug flags, then destroy it
-	else
-	{
-		fStamina = pStaminaComponent->GetCurrentStamina();
-
-		bIsInfiniteStaminaEnabled = pStaminaComponent->m_bIsInfiniteStaminaEnabled;
-		bAreDebugMessagesEnabled = pStaminaComponent->m_bAreDebugMessagesEnabled;
-		bShowDebugStaminaBar = pStaminaComponent->m_bShowDebugStaminaBar;
+}
 
-		pStaminaComponent->DestroyComponent();
+void ADropletPlayerCharacter::FillGroundProbe(FDropletGroundProbe& groundProbe, EDropletGroundSensingMode eMode, bool bCanConsumeAsync) const
+{
+	groundProbe.iSampleCount = 0;
+	for (int i = 0; i < FDropletGroundProbe::ProbeCount; ++i)
+	{
+		groundProbe.bHasHit[i] = false;
 	}
 
-	switch (eNewMaterialState)
+	if (eMode == EDropletGroundSensingMode::EDropletGroundSensingMode_ShapeSweep)
 	{
-	case EDropletMaterialState::EDropletMaterialState_Liquid:
-		pNewStaminaComponent = CastChecked<UStaminaComponent>(AddComponentByClass(LiquidStaminaComponent, false, FTransform::Identity, false));
-		break;
-	case EDropletMaterialState::EDropletMaterialState_Solid:
-		pNewStaminaComponent = CastChecked<UStaminaComponent>(AddComponentByClass(SolidStaminaComponent, false, FTransform::Identity, false));
-		break;
-	case EDropletMaterialState::EDropletMaterialState_Gazeous:
-		pNewStaminaComponent = CastChecked<UStaminaComponent>(AddComponentByClass(GazeousStaminaComponent, false, FTransform::Identity, false));
-		break;
-	default:
-	case EDropletMaterialState::EDropletMaterialState_None:
-		// Log error
-		UE_LOG(LogStamina, Error, TEXT("ADropletPlayerCharacter::ChangeStaminaComponent: eNewMaterialState is NONE!"));
-		break;
+		SweepGroundProbe(groundProbe);
+		return;
 	}
 
-	// If new stamina component is not nullptr, set debug flags
-	if (pNewStaminaComponent != nullptr)
+	// Use the probe ring submitted on the previous frame if possible, else trace it now
+	if (!bCanConsumeAsync || !ConsumeAsyncGroundProbe(groundProbe))
 	{
-		pNewStaminaComponent->SetCurrentStamina(fStamina);
-
-		pNewStaminaComponent->m_bIsInfiniteStaminaEnabled = bIsInfiniteStaminaEnabled;
-		pNewStaminaComponent->m_bAreDebugMessagesEnabled = bAreDebugMessagesEnabled;
-		pNewStaminaComponent->m_bShowDebugStaminaBar = bShowDebugStaminaBar;
+		for (int i = 0; i < FDropletGroundProbe::ProbeCount; ++i)
+		{
+			groundProbe.bHasHit[i] = GetHitLineTracedUnder(groundProbe.Hits[i], GetGroundProbeOffset(i));
+		}
 	}
+
+	groundProbe.iSampleCount = FDropletGroundProbe::ProbeCount;
 }
 
-void ADropletPlayerCharacter::ApplySpeedComponentStateValues(EDropletMaterialState eNewMaterialState)
+void ADropletPlayerCharacter::SweepGroundProbe(FDropletGroundProbe& groundProbe) const
 {
-	// If SpeedComponent is nullptr, add it
-	if (m_pSpeedComponent == nullptr)
-	{
-		m_pSpeedComponent = CastChecked<USpeedComponent>(AddComponentByClass(SpeedComponent, false, FTransform::Identity, false));
-		UE_LOG(LogSpeed, Warning, TEXT("ADropletPlayerCharacter::ApplySpeedComponentStateValues: SpeedComponent added"));
-	}
+	float fCapsuleRadius = GetCapsuleComponent()->GetScaledCapsuleRadius();
 
-	UCharacterMovementComponent* pCharacterMovement = GetCharacterMovement();
+	// Sweep a sphere of the capsule radius down so that its bottom reaches as low as the rays of the ring
+	FVector start = GetCapsuleComponent()->GetComponentLocation();
+	FVector end = start + FMath::Max(m_fLineTraceVLength - fCapsuleRadius, 0.f) * FVector::DownVector;
 
-	// Switch on the material state to apply the correct values
-	switch (eNewMaterialState)
-	{
-	case EDropletMaterialState::EDropletMaterialState_Liquid:
-		pCharacterMovement->MaxWalkSpeed = m_pSpeedComponent->m_fSpeedFlatMaxLiquid;
-		pCharacterMovement->MaxAcceleration = m_pSpeedComponent->m_fAccelerationFlatLiquid;
-		break;
-	case EDropletMaterialState::EDropletMaterialState_Solid:
-		pCharacterMovement->MaxWalkSpeed = m_pSpeedComponent->m_fSpeedFlatMaxSolid;
-		pCharacterMovement->MaxAcceleration = m_pSpeedComponent->m_fAccelerationFlatSolid;
-		m_bIsSlideDashing = true;
-		break;
-	case EDropletMaterialState::EDropletMaterialState_Gazeous:
-		pCharacterMovement->MaxFlySpeed = m_pSpeedComponent->m_fSpeedMaxGazeous;
-		pCharacterMovement->MaxAcceleration = m_pSpeedComponent->m_fAccelerationGazeous;
-		m_bIsGazeousDashing = true;
-		break;
-	default:
-	case EDropletMaterialState::EDropletMaterialState_None:
-		// Log error
-		UE_LOG(LogSpeed, Error, TEXT("ADropletPlayerCharacter::ApplySpeedComponentStateValues: eNewMaterialState is NONE!"));
-		break;
-	}
+	// A blocking sweep stops at its first hit, so every response is turned into an overlap to get one hit per component under the character
+	ECollisionChannel eTraceChannel = ECC_WorldStatic;
+	FCollisionResponseParams responseParams;
+	UCollisionProfile::GetChannelAndResponseParams(UCollisionProfile::BlockAll_ProfileName, eTraceChannel, responseParams);
+	responseParams.CollisionResponse.SetAllChannels(ECR_Overlap);
 
-	// If the character is on the ground and is in slide dash
-	if (m_bIsSlideDashing && pCharacterMovement->IsMovingOnGround())
-	{
-		// Prepare the slide dash values
+	CountIssuedTrace();
+	GetWorld()->SweepMultiByChannel(m_GroundSweepHits, start, end, FQuat::Identity, eTraceChannel,
+		FCollisionShape::MakeSphere(fCapsuleRadius), GetIgnoreCharacterLineTraceQueryParams(), responseParams);
 
-		m_vTransitionSpeedBoostStartVelocity = pCharacterMovement->Velocity.Length() <= m_fVelocityMovingTolerance ?
-			GetCapsuleComponent()->GetForwardVector() * m_pSpeedComponent->m_fLiquidToSolidSpeedBoostImpulseFactorNoMovement :
-			pCharacterMovement->Velocity;
+	// Closest surfaces first, they are the ones the character stands on
+	m_GroundSweepHits.Sort([](const FHitResult& A, const FHitResult& B) { return A.Time < B.Time; });
 
-		m_fTransitionSpeedBoostTarget = pCharacterMovement->Velocity.Length() + pCharacterMovement->Velocity.Length() * 0.5f;
-		m_fTransitionSpeedBoostElapsedTime = 0.f;
+	// Keep a slot for the movement floor
+	const int32 iMaxSweepSampleCount = FDropletGroundProbe::ProbeCount - 1;
+	int32 iSampleCount = 0;
 
-		// Add Breaker marker
-		m_bIsSlideDashBreaking = true;
-		AddInteractableMarker<UBreakerInteractableMarker>();
-	}
-	// Else if the character is in gazeous dash
-	else if (m_bIsGazeousDashing)
-	{
-		// Do the gazeous dash
-		pCharacterMovement->AddImpulse(
-			FVector::UpVector * (pCharacterMovement->IsMovingOnGround() ? m_pSpeedComponent->m_fLiquidToGazeousSpeedBoostImpulseFactor :
-				pCharacterMovement->Velocity.Z < 0.f ? m_pSpeedComponent->m_fLiquidToGazeousSpeedBoostImpulseFactor * 3 :
-				m_pSpeedComponent->m_fLiquidToGazeousSpeedBoostImpulseFactor)
-		);
-		m_bIsGazeousDashing = false;
-	}
-	// Else cancel the slide dash
-	else
+	// Vote on the surface normal of every component the ring rays would be blocked by
+	for (const FHitResult& sweepHit : m_GroundSweepHits)
 	{
-		m_bIsSlideDashing = false;
+		UPrimitiveComponent* pComponent = sweepHit.GetComponent();
+
+		//If the sweep started inside the component its normal is not the surface one, or the rays would go through it, skip it
+		if (sweepHit.bStartPenetrating || pComponent == nullptr || pComponent->GetCollisionResponseToChannel(eTraceChannel) != ECR_Block)
+		{
+			continue;
+		}
+
+		groundProbe.Hits[iSampleCount] = sweepHit;
+		groundProbe.bHasHit[iSampleCount] = true;
+
+		if (m_bSlopeDetectionDebugDrawLineEnabled)
+		{
+			DrawDebugPoint(GetWorld(), sweepHit.ImpactPoint, 12.f, FColor::Red, false, -1.f, 0);
+		}
+
+		if (++iSampleCount == iMaxSweepSampleCount)
+		{
+			break;
+		}
 	}
-}
 
-void ADropletPlayerCharacter::ApplyMaterialStateDurationAndCooldown(EDropletMaterialState eNewMaterialState)
-{
-	if (eNewMaterialState == EDropletMaterialState::EDropletMaterialState_Liquid || 
-		eNewMaterialState == EDropletMaterialState::EDropletMaterialState_None)
+	// The floor the movement component found for this frame's move is the last sample
+	const UCharacterMovementComponent* pCharacterMovement = GetCharacterMovement();
+	if (pCharacterMovement != nullptr && pCharacterMovement->IsMovingOnGround() && pCharacterMovement->CurrentFloor.bBlockingHit)
 	{
-		return;
+		groundProbe.Hits[iSampleCount] = pCharacterMovement->CurrentFloor.HitResult;
+		groundProbe.bHasHit[iSampleCount] = true;
+		++iSampleCount;
 	}
 
-	m_fCurrentStateDuration = eNewMaterialState == EDropletMaterialState::EDropletMaterialState_Solid ?
-		m_fSolidStateDuration : m_fGazeousStateDuration;
-
-	m_fCurrentStateChangeCooldown = eNewMaterialState == EDropletMaterialState::EDropletMaterialState_Solid ?
-		m_fSolidStateCooldown : m_fGazeousStateCooldown;
+	groundProbe.iSampleCount = iSampleCount;
 }
 
-float ADropletPlayerCharacter::GetSlopeAngle(FHitResult& Hit, FVector& vGlobalSlopeNormal) const
+void ADropletPlayerCharacter::VoteGroundProbe(FDropletGroundProbe& groundProbe, bool bDrawDebug) const
 {
-	float fSlopeAngle = 0.0f;
-
-	//Debug purpose vector (global slope normal)
-	vGlobalSlopeNormal = FVector::UpVector;
+	groundProbe.fSlopeAngle = 0.f;
+	groundProbe.vGlobalSlopeNormal = FVector::UpVector;
 
 	// Check several points around the player to get the slope angle -------------------------
-	float fNewTestSlopeAngle = 0.f;
-
-	FVector vOffset = FVector::ZeroVector;
-
-	uint8 uiTestNumber = 8;
-
 	uint8 uiCountFlatDetected = 0;
 	uint8 uiCountSlopeDetected = 0;
 	uint8 uiCountNothingDetected = 0;
 
-	for (int i = 0; i < uiTestNumber; ++i)
+	for (int i = 0; i < groundProbe.iSampleCount; ++i)
 	{
-		vOffset.X = FMath::Cos(i * PI / 4) * GetCapsuleComponent()->GetScaledCapsuleRadius();
-		vOffset.Y = FMath::Sin(i * PI / 4) * GetCapsuleComponent()->GetScaledCapsuleRadius();
+		const FHitResult& Hit = groundProbe.Hits[i];
 
 		//If the line trace hit something
-		if (GetHitLineTracedUnder(Hit, vOffset))
+		if (groundProbe.bHasHit[i])
 		{
 			//If the slope debug line trace is enabled
-			if (m_bSlopeDetectionDebugDrawLineEnabled)
+			if (bDrawDebug)
 			{
 				//Draw the impact normal
-				FVector start = GetCapsuleComponent()->GetComponentLocation() + vOffset;
+				FVector start = Hit.TraceStart;
 				FVector end = start + Hit.ImpactNormal * 200.f;
 				DrawDebugLine(
 					GetWorld(),
@@ -1241,7 +2999,7 @@ float ADropletPlayerCharacter::GetSlopeAngle(FHitResult& Hit, FVector& vGlobalSl
 			}
 
 			//Get the slope angle
-			fNewTestSlopeAngle = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(Hit.ImpactNormal, FVector::UpVector)));
+			float fNewTestSlopeAngle = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(Hit.ImpactNormal, FVector::UpVector)));
 
 			//Increment the counter if the slope angle is greater than the threshold
 			if (fNewTestSlopeAngle > m_fSlopeDetectionThreshold)
@@ -1253,204 +3011,246 @@ float ADropletPlayerCharacter::GetSlopeAngle(FHitResult& Hit, FVector& vGlobalSl
 			{
 				uiCountFlatDetected++;
 			}
+
+			//Register the global slope normal THEN the slope angle
+			if (fNewTestSlopeAngle > groundProbe.fSlopeAngle)
+			{
+				groundProbe.vGlobalSlopeNormal = Hit.ImpactNormal;
+				groundProbe.fSlopeAngle = fNewTestSlopeAngle;
+			}
 		}
 		else
 		{
 			uiCountNothingDetected++;
-			UE_LOG(LogMaterialStateMachine, VeryVerbose, TEXT("ADropletPlayerCharacter::GetSlopeAngle: GetHitLineTracedUnder number %i didn't hit something"), i + 1);
+			UE_LOG(LogMaterialStateMachine, VeryVerbose, TEXT("ADropletPlayerCharacter::VoteGroundProbe: probe number %i didn't hit something"), i + 1);
 		}
-
-		//Register the global slope normal
-		vGlobalSlopeNormal = fNewTestSlopeAngle > fSlopeAngle ? Hit.ImpactNormal : vGlobalSlopeNormal;
-		//THEN register the slope angle
-		fSlopeAngle = fNewTestSlopeAngle > fSlopeAngle ? fNewTestSlopeAngle : fSlopeAngle;
 	}
 	// ---------------------------------------------------------------------------------------
 
 	//If the line traces detected more flat than slope reset the slope angle
 	if (uiCountFlatDetected > uiCountSlopeDetected)
 	{
-		fSlopeAngle = 0.f;
-		vGlobalSlopeNormal = FVector::UpVector;
+		groundProbe.fSlopeAngle = 0.f;
+		groundProbe.vGlobalSlopeNormal = FVector::UpVector;
 	}
 
 	//If the slope debug line trace is enabled
-	if (m_bSlopeDetectionDebugDrawLineEnabled)
+	if (bDrawDebug)
 	{
 		//Draw the global slope normal
 		FVector start = GetCapsuleComponent()->GetComponentLocation();
-		FVector end = start + vGlobalSlopeNormal * 300.f;
+		FVector end = start + groundProbe.vGlobalSlopeNormal * 300.f;
 		DrawDebugLine(
 			GetWorld(),
 			start,
 			end,
-			fSlopeAngle == 0.f ? FColor::Green : fSlopeAngle >= m_fMaxSlopeAngle ? FColor::Red : FColor::Yellow,
+			groundProbe.fSlopeAngle == 0.f ? FColor::Green : groundProbe.fSlopeAngle >= m_fMaxSlopeAngle ? FColor::Red : FColor::Yellow,
 			false, -1.f, 0,
 			12.333
 		);
 	}
+}
 
-	return fSlopeAngle;
+void ADropletPlayerCharacter::RecordGroundSensingCost(EDropletGroundSensingMode eMode, uint64 uiCycles) const
+{
+	float fCostMs = FPlatformTime::ToMilliseconds64(uiCycles);
+	float& fAverageCostMs = m_fGroundSensingAverageCostMs[static_cast<uint8>(eMode)];
+
+	// Exponential moving average so the cost stays readable on screen
+	fAverageCostMs = fAverageCostMs <= 0.f ? fCostMs : FMath::Lerp(fAverageCostMs, fCostMs, 0.05f);
 }
 
-bool ADropletPlayerCharacter::IsAscending() const
+void ADropletPlayerCharacter::CompareGroundSensingModes() const
 {
-	// Check if we are NOT moving
-	if (GetCharacterMovement()->Velocity.Size() <= m_fVelocityMovingTolerance)
-	{
-		return false;
-	}
+	EDropletGroundSensingMode eOtherMode = m_eGroundSensingMode == EDropletGroundSensingMode::EDropletGroundSensingMode_RayRing ?
+		EDropletGroundSensingMode::EDropletGroundSensingMode_ShapeSweep : EDropletGroundSensingMode::EDropletGroundSensingMode_RayRing;
 
-	bool bAscending = false;
+	uint64 uiStartCycles = FPlatformTime::Cycles64();
 
-	FHitResult hit;
+	// Always trace the other mode synchronously so both are measured on the same ground
+	FDropletGroundProbe otherGroundProbe;
+	FillGroundProbe(otherGroundProbe, eOtherMode, false);
+	VoteGroundProbe(otherGroundProbe, false);
 
-	FVector vOffset = FVector::ZeroVector;
-	for (int i = 0; i < 8; ++i)
-	{
-		vOffset.X = FMath::Cos(i * PI / 4) * GetCapsuleComponent()->GetScaledCapsuleRadius();
-		vOffset.Y = FMath::Sin(i * PI / 4) * GetCapsuleComponent()->GetScaledCapsuleRadius();
+	RecordGroundSensingCost(eOtherMode, FPlatformTime::Cycles64() - uiStartCycles);
 
-		if (GetHitLineTracedUnder(hit, vOffset))
-		{
-			float fAngle = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(hit.ImpactNormal, GetCharacterMovement()->Velocity.GetSafeNormal())));
+	float fAngleError = FMath::Abs(otherGroundProbe.fSlopeAngle - m_GroundProbe.fSlopeAngle);
+	bool bSameFlatVote = (otherGroundProbe.fSlopeAngle < m_fFlatSurfaceTolerance) == (m_GroundProbe.fSlopeAngle < m_fFlatSurfaceTolerance);
 
-			bAscending = bAscending || fAngle > 90.f;
-		}
+	m_fGroundSensingAverageAngleError = FMath::Lerp(m_fGroundSensingAverageAngleError, fAngleError, 0.05f);
+	m_fGroundSensingMaxAngleError = FMath::Max(m_fGroundSensingMaxAngleError, fAngleError);
+	m_uiGroundSensingComparisonCount++;
+	m_uiGroundSensingFlatVoteMismatchCount += bSameFlatVote ? 0 : 1;
+
+	UE_LOG(LogMaterialStateMachine, VeryVerbose, TEXT("ADropletPlayerCharacter::CompareGroundSensingModes: ray ring %f, shape sweep %f"),
+		m_eGroundSensingMode == EDropletGroundSensingMode::EDropletGroundSensingMode_RayRing ? m_GroundProbe.fSlopeAngle : otherGroundProbe.fSlopeAngle,
+		m_eGroundSensingMode == EDropletGroundSensingMode::EDropletGroundSensingMode_RayRing ? otherGroundProbe.fSlopeAngle : m_GroundProbe.fSlopeAngle);
+}
+
+void ADropletPlayerCharacter::SetGroundSensingMode(EDropletGroundSensingMode eNewMode)
+{
+	if (m_eGroundSensingMode == eNewMode)
+	{
+		return;
 	}
 
-	return bAscending;
+	m_eGroundSensingMode = eNewMode;
+
+	// Don't serve the new mode with probes of the previous one
+	InvalidateGroundProbeCache();
+	m_uiAsyncGroundProbeSubmitFrame = MAX_uint64;
 }
 
-bool ADropletPlayerCharacter::IsOnFlat() const
+bool ADropletPlayerCharacter::IsGroundProbeCacheValid() const
 {
-	FHitResult hit;
-	FVector vHitNormal;
-	float fSlopeAngle = GetSlopeAngle(hit, vHitNormal);
+	if (!m_bUseGroundProbeCache || !m_bIsGroundProbeCacheValid)
+	{
+		return false;
+	}
 
-	return fSlopeAngle <= m_fFlatSurfaceTolerance;
+	// The cached primitive must still exist and be unable to move
+	UPrimitiveComponent* pPrimitive = m_pGroundProbeCachePrimitive.Get();
+	if (pPrimitive == nullptr || pPrimitive->Mobility != EComponentMobility::Static)
+	{
+		return false;
+	}
+
+	// The character must still be standing on the cached primitive
+	const UCharacterMovementComponent* pCharacterMovement = GetCharacterMovement();
+	if (pCharacterMovement == nullptr || !pCharacterMovement->CurrentFloor.IsWalkableFloor() ||
+		pCharacterMovement->CurrentFloor.HitResult.GetComponent() != pPrimitive)
+	{
+		return false;
+	}
+
+	// And close enough to where the ring was fired from
+	return FVector::DistSquared(GetCapsuleComponent()->GetComponentLocation(), m_vGroundProbeCacheLocation) <= FMath::Square(m_fGroundProbeCacheDistance);
 }
 
-void ADropletPlayerCharacter::Landed(const FHitResult& Hit)
+void ADropletPlayerCharacter::StoreGroundProbeCache() const
 {
-	Super::Landed(Hit);
+	m_bIsGroundProbeCacheValid = false;
 
-	// If the DropletPlayerController is not valid return
-	if (m_pDropletPlayerController == nullptr)
+	if (!m_bUseGroundProbeCache || !m_GroundProbe.bHasHit[0])
 	{
-		UE_LOG(LogTemp, Error, TEXT("ADropletPlayerCharacter::Landed: m_pDropletPlayerController is nullptr"));
 		return;
 	}
 
-	// If the material state is liquid
-	if (m_pDropletPlayerController->GetMaterialState() == EDropletMaterialState::EDropletMaterialState_Liquid)
+	// Only cache a ring which entirely hit the same static primitive, edges and moving ground are traced every frame
+	UPrimitiveComponent* pPrimitive = m_GroundProbe.Hits[0].GetComponent();
+	if (pPrimitive == nullptr || pPrimitive->Mobility != EComponentMobility::Static)
 	{
-		// If the character is not splashing and can splash
-		if (!m_bIsSplashing && m_bCanSplash)
+		return;
+	}
+
+	for (int i = 1; i < m_GroundProbe.iSampleCount; ++i)
+	{
+		if (!m_GroundProbe.bHasHit[i] || m_GroundProbe.Hits[i].GetComponent() != pPrimitive)
 		{
-			Splash(Hit);
+			return;
 		}
+	}
 
-		BPE_OnLanded(EDropletMaterialState::EDropletMaterialState_Liquid);
+	// Key the cache on where the ring was fired from, which is last frame's location for async probes
+	m_vGroundProbeCacheLocation = m_eGroundSensingMode == EDropletGroundSensingMode::EDropletGroundSensingMode_RayRing ?
+		m_GroundProbe.Hits[0].TraceStart - GetGroundProbeOffset(0) : m_GroundProbe.Hits[0].TraceStart;
+	m_pGroundProbeCachePrimitive = pPrimitive;
+	m_bIsGroundProbeCacheValid = true;
+}
 
-		m_bCanSplash = false;
-	}
-	// Else if the material state is solid
-	else if (m_pDropletPlayerController->GetMaterialState() == EDropletMaterialState::EDropletMaterialState_Solid)
-	{
-		BPE_OnLanded(EDropletMaterialState::EDropletMaterialState_Solid);
-	}
+float ADropletPlayerCharacter::GetGroundProbeCacheHitRate() const
+{
+	uint32 uiRequestCount = m_uiGroundProbeCacheHits + m_uiGroundProbeCacheMisses;
+
+	return uiRequestCount > 0 ? static_cast<float>(m_uiGroundProbeCacheHits) / uiRequestCount : 0.f;
 }
 
-#pragma region InterctableMarkers
-TArray<UInteractableMarker*> ADropletPlayerCharacter::GetInteractableMarkers() const
+void ADropletPlayerCharacter::InvalidateGroundProbeCache()
 {
-	return m_InteractableMarkers;
+	m_bIsGroundProbeCacheValid = false;
+	m_pGroundProbeCachePrimitive.Reset();
+
+	// Also force the ring to be fired again if it was already fired this frame
+	m_GroundProbe.uiFrameNumber = MAX_uint64;
 }
 
-template <typename T>
-void ADropletPlayerCharacter::AddInteractableMarker()
+void ADropletPlayerCharacter::ResetGroundProbeCacheStats()
 {
-	// If the interactable marker is not already in the array
-	if (!m_InteractableMarkers.ContainsByPredicate([this](UInteractableMarker* pInteractableMarker)
-		{ return Cast<T>(pInteractableMarker); }))
-	{
-		// Add the interactable marker to the array
-		m_InteractableMarkers.Add(NewObject<T>(this));
+	m_uiGroundProbeCacheHits = 0;
+	m_uiGroundProbeCacheMisses = 0;
+}
 
-		// Log the interactable marker is added
-		UE_LOG(LogInteractable, Warning, TEXT("ADropletPlayerCharacter::AddInteractableMarker: Added %s"), *m_InteractableMarkers.Last()->GetName());
-	}
+FVector ADropletPlayerCharacter::GetGroundProbeOffset(int32 iProbeIndex) const
+{
+	float fCapsuleRadius = GetCapsuleComponent()->GetScaledCapsuleRadius();
+
+	// Spread the probes evenly on a circle of the capsule radius
+	float fAngle = iProbeIndex * 2.f * PI / FDropletGroundProbe::ProbeCount;
+
+	return FVector(FMath::Cos(fAngle) * fCapsuleRadius, FMath::Sin(fAngle) * fCapsuleRadius, 0.f);
 }
 
-template <typename T>
-void ADropletPlayerCharacter::RemoveInteractableMarker()
+void ADropletPlayerCharacter::SubmitAsyncGroundProbe()
 {
-	// If the interactable marker is not already in the array
-	if (!m_InteractableMarkers.ContainsByPredicate([this](UInteractableMarker* pInteractableMarker)
-		{ return Cast<T>(pInteractableMarker); }))
+	UWorld* pWorld = GetWorld();
+	if (pWorld == nullptr)
 	{
 		return;
 	}
 
-	// For each interactable marker
-	for (UInteractableMarker* pInteractableMarker : m_InteractableMarkers)
+	const FCollisionQueryParams& queryParams = GetIgnoreCharacterLineTraceQueryParams();
+
+	for (int i = 0; i < FDropletGroundProbe::ProbeCount; ++i)
 	{
-		// If the interactable marker is valid
-		if (pInteractableMarker != nullptr)
-		{
-			// If the interactable marker is of the type to remove
-			if (Cast<T>(pInteractableMarker))
-			{
-				m_InteractableMarkers.Remove(pInteractableMarker);
-				break;
-			}
-		}
+		FVector start = GetCapsuleComponent()->GetComponentLocation() + GetGroundProbeOffset(i);
+		FVector end = start + m_fLineTraceVLength * FVector::DownVector;
+
+		CountIssuedTrace();
+		m_AsyncGroundProbeHandles[i] = pWorld->AsyncLineTraceByProfile(EAsyncTraceType::Single, start, end, UCollisionProfile::BlockAll_ProfileName, queryParams);
 	}
+
+	m_uiAsyncGroundProbeSubmitFrame = GFrameCounter;
 }
 
-template <typename T>
-bool ADropletPlayerCharacter::HasInteractableMarker() const
+bool ADropletPlayerCharacter::ConsumeAsyncGroundProbe(FDropletGroundProbe& groundProbe) const
 {
-	// For each interactable marker
-	for (UInteractableMarker* pInteractableMarker : m_InteractableMarkers)
+	// The ring must have been submitted on the previous frame (not on the first frame, after a teleport or a skipped frame)
+	if (!m_bUseAsyncGroundProbe || m_eGroundSensingMode != EDropletGroundSensingMode::EDropletGroundSensingMode_RayRing ||
+		m_uiAsyncGroundProbeSubmitFrame == MAX_uint64 || m_uiAsyncGroundProbeSubmitFrame + 1 != GFrameCounter)
 	{
-		// If the interactable marker is valid
-		if (pInteractableMarker != nullptr)
-		{
-			// If the interactable marker is of the type to remove
-			if (Cast<T>(pInteractableMarker))
-			{
-				return true;
-			}
-		}
+		return false;
 	}
 
-	return false;
-}
+	UWorld* pWorld = GetWorld();
+	if (pWorld == nullptr)
+	{
+		return false;
+	}
 
-bool ADropletPlayerCharacter::BPF_HasBreakerMarker() const
-{
-	return HasInteractableMarker<UBreakerInteractableMarker>();
-}
+	FTraceDatum traceDatum;
+	for (int i = 0; i < FDropletGroundProbe::ProbeCount; ++i)
+	{
+		// If one of the traces is not ready, fall back to synchronous traces for the whole ring
+		if (!pWorld->QueryTraceData(m_AsyncGroundProbeHandles[i], traceDatum))
+		{
+			UE_LOG(LogMaterialStateMachine, Verbose, TEXT("ADropletPlayerCharacter::ConsumeAsyncGroundProbe: async probe number %i is not ready"), i + 1);
+			return false;
+		}
 
-bool ADropletPlayerCharacter::BPF_HasDrillerMarker() const
-{
-	return HasInteractableMarker<UDrillerInteractableMarker>();
-}
+		groundProbe.bHasHit[i] = traceDatum.OutHits.Num() > 0 && traceDatum.OutHits[0].bBlockingHit;
+		groundProbe.Hits[i] = groundProbe.bHasHit[i] ? traceDatum.OutHits[0] : FHitResult();
+	}
 
-void ADropletPlayerCharacter::ClearInteractableMarkers()
-{
-	m_InteractableMarkers.Empty();
+	return true;
 }
-#pragma endregion
 
 bool ADropletPlayerCharacter::GetHitLineTracedUnder(FHitResult& Hit, FVector vOffset /* = FVector::ZeroVector */, float fOvverideLineTraceVLength /* = -1.f */) const
 {
+	DROPLET_SCOPE(STAT_DropletGetHitLineTracedUnder, "Droplet::GetHitLineTracedUnder");
+
 	FVector start = GetCapsuleComponent()->GetComponentLocation() + vOffset;
 	// Use either the override length if it's positive or the default length otherwise
 	FVector end = start + (fOvverideLineTraceVLength >= 0.f ? fOvverideLineTraceVLength : m_fLineTraceVLength) * FVector::DownVector;
-	FName profileName = TEXT("BlockAll");
 
 	if (fOvverideLineTraceVLength >= 0.f && m_bIsSplashDebugDrawLineEnabled)
 	{
@@ -1479,17 +3279,56 @@ bool ADropletPlayerCharacter::GetHitLineTracedUnder(FHitResult& Hit, FVector vOf
 		);
 	}
 
-	return GetWorld()->LineTraceSingleByProfile(Hit, start, end, profileName, GetIgnoreCharacterLineTraceQueryParams());
+	CountIssuedTrace();
+	return GetWorld()->LineTraceSingleByProfile(Hit, start, end, UCollisionProfile::BlockAll_ProfileName, GetIgnoreCharacterLineTraceQueryParams());
+}
+
+const FCollisionQueryParams& ADropletPlayerCharacter::GetIgnoreCharacterLineTraceQueryParams() const
+{
+	// Build the ignore set only when the child actors changed since the last build
+	if (m_bIsIgnoreCharacterQueryParamsDirty)
+	{
+		m_IgnoreCharacterQueryParams.ClearIgnoredActors();
+
+		TArray<AActor*> characterChildren;
+		GetAllChildActors(characterChildren);
+		m_IgnoreCharacterQueryParams.AddIgnoredActors(characterChildren);
+		m_IgnoreCharacterQueryParams.AddIgnoredActor(this);
+
+		m_bIsIgnoreCharacterQueryParamsDirty = false;
+	}
+
+	return m_IgnoreCharacterQueryParams;
+}
+
+void ADropletPlayerCharacter::OnWorldActorSpawned(AActor* pActor)
+{
+	//If a child actor was created, rebuild the Query Parameters on the next trace
+	if (IsChildActorOfCharacter(pActor))
+	{
+		MarkIgnoreCharacterQueryParamsDirty();
+	}
 }
 
-FCollisionQueryParams ADropletPlayerCharacter::GetIgnoreCharacterLineTraceQueryParams() const
+void ADropletPlayerCharacter::OnWorldActorDestroyed(AActor* pActor)
 {
-	FCollisionQueryParams queryParams;
+	//If a child actor was destroyed, rebuild the Query Parameters on the next trace
+	if (IsChildActorOfCharacter(pActor))
+	{
+		MarkIgnoreCharacterQueryParamsDirty();
+	}
+}
 
-	TArray<AActor*> characterChildren;
-	GetAllChildActors(characterChildren);
-	queryParams.AddIgnoredActors(characterChildren);
-	queryParams.AddIgnoredActor(this);
+bool ADropletPlayerCharacter::IsChildActorOfCharacter(const AActor* pActor) const
+{
+	// Go up the child actor components the actor is nested in
+	for (const AActor* pParentActor = pActor != nullptr ? pActor->GetParentActor() : nullptr; pParentActor != nullptr; pParentActor = pParentActor->GetParentActor())
+	{
+		if (pParentActor == this)
+		{
+			return true;
+		}
+	}
 
-	return queryParams;
+	return false;
 }
@@ -11,10 +11,15 @@
 #include "../Components/SpeedComponent.h"
 #include "../Components/Interactables/InteractableMarker.h"
 #include "Components/SphereComponent.h"
+#include "WorldCollision.h"
+#include "Player/DropletReplayRecorder.h"
 
 #include "DropletPlayerCharacter.generated.h"
 
 class ADropletPlayerController;
+class UInputInteractableActorComponent;
+class UMaterialInstanceDynamic;
+class UCurveFloat;
 
 //Delegate for player movement
 DECLARE_DYNAMIC_DELEGATE_OneParam(FMoveFunction, const FInputActionValue&, Value);
@@ -23,6 +28,272 @@ DECLARE_DYNAMIC_DELEGATE_OneParam(FMoveFunction, const FInputActionValue&, Value
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FStateChanged, EDropletMaterialState, eNewMaterialState);
 
 
+/** How the ground under the character is sensed */
+UENUM(BlueprintType)
+enum class EDropletGroundSensingMode : uint8
+{
+	EDropletGroundSensingMode_RayRing UMETA(DisplayName = "Ray Ring"),
+	EDropletGroundSensingMode_ShapeSweep UMETA(DisplayName = "Shape Sweep"),
+	EDropletGroundSensingMode_Count UMETA(Hidden)
+};
+
+
+/**
+ * Result of one pass of the ground sensing under the character (probe ring or shape sweep),
+ * shared by every ground query made during the same frame
+ */
+struct FDropletGroundProbe
+{
+	// Number of line traces in the probe ring
+	static constexpr int32 ProbeCount = 8;
+
+	// Hit result of each sample, the probes of the ring or the sweep hits followed by the movement floor
+	FHitResult Hits[ProbeCount];
+	// Whether each sample hit something
+	bool bHasHit[ProbeCount] = {};
+	// Number of samples filled, ProbeCount for the ring, the blocking sweep hits plus the movement floor when walking for the sweep
+	int32 iSampleCount = 0;
+
+	// Slope angle voted by the ring
+	float fSlopeAngle = 0.f;
+	// Global slope normal voted by the ring
+	FVector vGlobalSlopeNormal = FVector::UpVector;
+
+	// Frame on which the ring was fired
+	uint64 uiFrameNumber = MAX_uint64;
+};
+
+/** List of interactable marker types, giving each one its position as compile-time index */
+template <typename... TMarkers>
+struct TDropletInteractableMarkerTypeList
+{
+	static constexpr int32 Count = sizeof...(TMarkers);
+
+	/** Returns the position of T in the list, INDEX_NONE if it is not in it */
+	template <typename T>
+	static constexpr int32 IndexOf()
+	{
+		int32 iIndex = INDEX_NONE;
+		int32 iPosition = 0;
+		((std::is_same_v<T, TMarkers> ? iIndex = iPosition++ : iPosition++), ...);
+		return iIndex;
+	}
+
+	/** Returns a mask with the bit of every listed type the object is an instance of */
+	template <typename TObject>
+	static uint8 GetTypeMask(const TObject* pObject)
+	{
+		return pObject == nullptr ? 0 : static_cast<uint8>(((pObject->template IsA<TMarkers>() ? 1 << IndexOf<TMarkers>() : 0) | ... | 0));
+	}
+};
+
+/** Every interactable marker type of the character's marker bitmask, a new marker type only needs to be added here */
+using FDropletInteractableMarkerTypes = TDropletInteractableMarkerTypeList<UBreakerInteractableMarker, UDrillerInteractableMarker>;
+
+/** Compile-time index of an interactable marker type in the character's marker bitmask */
+template <typename T>
+struct TDropletInteractableMarkerBit
+{
+	static constexpr int32 Index = FDropletInteractableMarkerTypes::IndexOf<T>();
+	static_assert(Index != INDEX_NONE, "The marker type must be added to FDropletInteractableMarkerTypes");
+};
+
+
+/**
+ * Cached pointer to a component of the character, resolved once
+ * and invalidated whenever the component it points to is swapped
+ */
+template <typename T>
+struct TDropletComponentHandle
+{
+	// Returns the cached component
+	T* Get() const { return pComponent.Get(); }
+
+	// Caches the component
+	void Set(T* pNewComponent)
+	{
+		pComponent = pNewComponent;
+		bIsResolved = true;
+	}
+
+	// Drops the cached component, it has to be resolved again
+	void Invalidate()
+	{
+		pComponent.Reset();
+		bIsResolved = false;
+	}
+
+	// Whether the component was resolved since the last invalidation
+	bool IsResolved() const { return bIsResolved && (pComponent.IsValid() || pComponent.IsExplicitlyNull()); }
+
+private:
+	TWeakObjectPtr<T> pComponent;
+	bool bIsResolved = false;
+};
+
+
+/**
+ * Actor in range of the interactable range sphere,
+ * with its interaction components resolved when it entered the range
+ */
+struct FDropletInteractableCandidate
+{
+	// Actor overlapping the interactable range sphere
+	TWeakObjectPtr<AActor> pActor;
+	// InputInteractableActorComponent of the actor
+	TWeakObjectPtr<UInputInteractableActorComponent> pInteractableComponent;
+
+	// Whether we can interact with the actor, computed once per frame
+	bool bIsInteractable = false;
+	// Distance of the actor's root component to the character, computed once per frame
+	float fDistance = 0.f;
+};
+
+
+#if !UE_BUILD_SHIPPING
+/** Parts of the droplet logic timed by the benchmark */
+enum class EDropletBenchmarkSection : uint8
+{
+	EDropletBenchmarkSection_Tick,
+	EDropletBenchmarkSection_GetSlopeAngle,
+	EDropletBenchmarkSection_HandleInteractionButtonDisplay,
+	EDropletBenchmarkSection_SetMaterialState,
+
+	EDropletBenchmarkSection_Count
+};
+
+
+/**
+ * Per frame cost of one benchmark section, summed over the calls of a frame
+ * and kept in a bounded ring of frames to be summarized as percentiles
+ */
+struct FDropletCostSampler
+{
+	// Number of frames kept, the oldest ones are overwritten
+	static constexpr int32 MaxFrameCount = 16384;
+
+	// Cost of each recorded frame in ms
+	TArray<float> FrameCostsMs;
+	// Index of the next frame to overwrite once the ring is full
+	int32 iNextFrameIndex = 0;
+	// Cost of the frame being recorded in ms
+	float fCurrentFrameCostMs = 0.f;
+	// Frame being recorded
+	uint64 uiCurrentFrameNumber = MAX_uint64;
+
+	/** Called to add the cost of one call, the previous frame is stored when a new frame starts */
+	void AddCost(float fCostMs);
+
+	/** Called to store the frame being recorded */
+	void Flush();
+
+	/** Called to drop every recorded frame */
+	void Reset();
+
+	/** Returns the cost under which fPercentile percent of the recorded frames are */
+	float GetPercentile(float fPercentile) const;
+
+	/** Times its scope and adds it to the sampler if there is one */
+	struct FScope
+	{
+		FScope(FDropletCostSampler* pInSampler) : pSampler(pInSampler), uiStartCycles(pInSampler != nullptr ? FPlatformTime::Cycles64() : 0) {}
+		~FScope()
+		{
+			if (pSampler != nullptr)
+			{
+				pSampler->AddCost(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - uiStartCycles));
+			}
+		}
+
+		FDropletCostSampler* pSampler;
+		uint64 uiStartCycles;
+	};
+};
+#endif // !UE_BUILD_SHIPPING
+
+
+/**
+ * Float curve baked into evenly spaced samples over the normalized time [0, 1],
+ * evaluated with a linear interpolation between the two closest samples
+ */
+struct FDropletBakedCurve
+{
+	// Number of intervals between the samples
+	static constexpr int32 IntervalCount = 64;
+
+	// Curve the samples were baked from
+	TWeakObjectPtr<const UCurveFloat> pSourceCurve;
+	// Values of the source curve at i / IntervalCount
+	float Samples[IntervalCount + 1] = {};
+	// Whether the samples hold a baked curve
+	bool bIsBaked = false;
+
+	/** Called to sample the source curve, returns false if it is already the baked one */
+	bool Bake(const UCurveFloat* pCurve);
+
+	/** Returns the biggest difference between the baked samples and the source curve over iCheckCount evaluations */
+	float ComputeMaxError(int32 iCheckCount) const;
+
+	/** Returns the baked value at the normalized time, clamped to [0, 1] */
+	float Evaluate(float fTime) const
+	{
+		float fSample = FMath::Clamp(fTime, 0.f, 1.f) * IntervalCount;
+		int32 iIndex = FMath::Min(FMath::FloorToInt32(fSample), IntervalCount - 1);
+
+		return FMath::Lerp(Samples[iIndex], Samples[iIndex + 1], fSample - iIndex);
+	}
+};
+
+
+/**
+ * Values of one MaterialState read by the movement, gathered from the character and the SpeedComponent
+ * when the state changes so the Tick reads them from one place
+ */
+struct FDropletMaterialStateRecord
+{
+	// Whether the slope speed governor drives MaxWalkSpeed in this state, else MaxWalkSpeed is kept as is
+	bool bHasGroundSpeeds = false;
+	// Whether an empty stamina slows the character down on ascending slopes instead of the StaminaComponent stopping it
+	bool bIsSlowedDownByEmptyStamina = false;
+	// Whether the state only lasts m_fStateDuration before going back to liquid
+	bool bHasStateDuration = false;
+
+	// Slope speed governor values
+	float fMaxAscendingSpeed = 0.f;
+	float fMinAscendingSpeed = 0.f;
+	float fMaxDescendingSpeed = 0.f;
+	float fMaxFlatSpeed = 0.f;
+	float fAscendingFactor = 0.f;
+	float fAscendingFactorEmptyStamina = 0.f;
+	float fDescendingFactor = 0.f;
+
+	// CharacterMovementComponent values applied when entering the state
+	float fMaxAcceleration = 0.f;
+	float fMaxFlySpeed = 0.f;
+
+	// Duration and cooldown of the state
+	float fStateDuration = 0.f;
+	float fStateCooldown = 0.f;
+};
+
+
+/**
+ * Material parameters pushed to the blended state material when entering a MaterialState
+ */
+USTRUCT(BlueprintType)
+struct FDropletMaterialStateParameters
+{
+	GENERATED_BODY()
+
+	// Scalar parameters of the state, by parameter name
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletMaterialStateParameters", meta = (DisplayName = "Scalar Parameters"))
+	TMap<FName, float> ScalarParameters;
+	// Vector parameters of the state, by parameter name
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletMaterialStateParameters", meta = (DisplayName = "Vector Parameters"))
+	TMap<FName, FLinearColor> VectorParameters;
+};
+
+
 /**
  * The DropletPlayerCharacter class to represent the player character in the game
  */
@@ -53,6 +324,17 @@ class ADropletPlayerCharacter : public AVeinPlayerCharacter
 	/** GazeousMappingContext */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DropletPlayerCharacter|Input", meta = (AllowPrivateAccess = "true"))
 	class UInputMappingContext* GazeousMappingContext;
+
+	/** Priority the MaterialState's mapping context is registered with, relative to the other contexts of the player */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Input", meta = (AllowPrivateAccess = "true", DisplayName = "Material State Mapping Context Priority"))
+	int32 m_iMaterialStateMappingContextPriority = 0;
+
+	/**
+	 * Call the MaterialState's move function by name through the dynamic delegate for every state.
+	 * When disabled, the direct call is used for the states whose class doesn't override or hide the move function, the others still use the delegate.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DropletPlayerCharacter|Input", meta = (AllowPrivateAccess = "true", DisplayName = "Use Reflected Move Dispatch"))
+	bool m_bUseReflectedMoveDispatch = false;
 #pragma endregion
 
 
@@ -79,6 +361,8 @@ class ADropletPlayerCharacter : public AVeinPlayerCharacter
 
 public:
 	friend class UDropletMaterialStateDescription;
+	// Runs the splash, slide dash and fall rules inside the movement simulation
+	friend class UDropletCharacterMovementComponent;
 
 public:
 	/** Assigns the right modifications depending on the DropletMaterialState passed as argument */
@@ -174,6 +458,25 @@ public:
 	float m_fLineTraceVLength = 100.f;
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|SlopeDetection", meta = (DisplayName = "Slop Detetction Threshold"))
 	float m_fSlopeDetectionThreshold = 1.f;
+	// Sense the ground with the ring of line traces or with the ring traced against the components found by a shape sweep
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|SlopeDetection", meta = (DisplayName = "Ground Sensing Mode"))
+	EDropletGroundSensingMode m_eGroundSensingMode = EDropletGroundSensingMode::EDropletGroundSensingMode_RayRing;
+	// Also run the other ground sensing mode every probe to compare their cost and slope angle
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DropletPlayerCharacter|SlopeDetection", meta = (DisplayName = "Compare Ground Sensing Modes"))
+	bool m_bCompareGroundSensingModes = false;
+	// Submit the probe ring with async traces at the end of a frame and consume it on the next one
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DropletPlayerCharacter|SlopeDetection", meta = (DisplayName = "Use Async Ground Probe"))
+	bool m_bUseAsyncGroundProbe = false;
+	// Reuse the last probe ring while the capsule stays on the same static ground
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DropletPlayerCharacter|SlopeDetection", meta = (DisplayName = "Use Ground Probe Cache"))
+	bool m_bUseGroundProbeCache = true;
+	// Distance the capsule can move away from where the cached probe ring was fired in cm
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DropletPlayerCharacter|SlopeDetection", meta = (DisplayName = "Ground Probe Cache Distance", EditCondition = "m_bUseGroundProbeCache"))
+	float m_fGroundProbeCacheDistance = 5.f;
+
+	// Frame rate the ascending and descending factors were tuned at, they are applied as a speed change per second of factor * rate
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|SlopeDetection", meta = (DisplayName = "Slope Speed Governor Reference Rate", ClampMin = "1"))
+	float m_fSlopeSpeedGovernorReferenceRate = 60.f;
 
 	// Distance threshold to the ground to be able to splash
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|SplashDetection", meta = (DisplayName = "Splash Detetction Threshold"))
@@ -181,37 +484,99 @@ public:
 
 
 
+	// ----------------------------------- Interaction related settings ---------------------------------------------------
+
+	// Distance another interactable must be closer than the current target by to become the target
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Interaction", meta = (DisplayName = "Interactable Target Switch Margin"))
+	float m_fInteractableTargetSwitchMargin = 20.f;
+
+
+
 	// ----------------------------------- Art related settings -----------------------------------------------------------
 
-	/** Liquid material instance */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Materials", meta = (DisplayName = "Liquid Material Instance"))
-	class UMaterialInstance* m_pLiquidMaterialInstance = nullptr;
-	/** Solid material instance */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Materials", meta = (DisplayName = "Solid Material Instance"))
-	class UMaterialInstance* m_pSolidMaterialInstance = nullptr;
-	/** Gazeous material instance */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Materials", meta = (DisplayName = "Gazeous Material Instance"))
-	class UMaterialInstance* m_pGazeousMaterialInstance = nullptr;
-
-	/** Liquid skeletal mesh instance */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Meshes", meta = (DisplayName = "Liquid Skeletal Mesh Instance"))
-	class USkeletalMesh* m_pLiquidSKInstance = nullptr;
-	/** Solid skeletal mesh instance */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Meshes", meta = (DisplayName = "Solid Skeletal Mesh Instance"))
-	class USkeletalMesh* m_pSolidSKInstance = nullptr;
-	/** Gazeous skeletal mesh instance */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Meshes", meta = (DisplayName = "Gazeous Skeletal Mesh Instance"))
-	class USkeletalMesh* m_pGazeousSKInstance = nullptr;
+	/** Liquid material instance, streamed in after BeginPlay */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Materials", meta = (DisplayName = "Liquid Material Instance (Streamed)"))
+	TSoftObjectPtr<UMaterialInstance> m_LiquidMaterialInstanceSoft;
+	/** Solid material instance, streamed in after BeginPlay */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Materials", meta = (DisplayName = "Solid Material Instance (Streamed)"))
+	TSoftObjectPtr<UMaterialInstance> m_SolidMaterialInstanceSoft;
+	/** Gazeous material instance, streamed in after BeginPlay */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Materials", meta = (DisplayName = "Gazeous Material Instance (Streamed)"))
+	TSoftObjectPtr<UMaterialInstance> m_GazeousMaterialInstanceSoft;
+
+	/** Liquid skeletal mesh instance, streamed in after BeginPlay */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Meshes", meta = (DisplayName = "Liquid Skeletal Mesh Instance (Streamed)"))
+	TSoftObjectPtr<USkeletalMesh> m_LiquidSKInstanceSoft;
+	/** Solid skeletal mesh instance, streamed in after BeginPlay */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Meshes", meta = (DisplayName = "Solid Skeletal Mesh Instance (Streamed)"))
+	TSoftObjectPtr<USkeletalMesh> m_SolidSKInstanceSoft;
+
+	// Hard references the assets were set with before they were streamed, moved to the streamed references in PostLoad
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Use Liquid Material Instance (Streamed) instead"))
+	TObjectPtr<UMaterialInstance> m_pLiquidMaterialInstance_DEPRECATED = nullptr;
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Use Solid Material Instance (Streamed) instead"))
+	TObjectPtr<UMaterialInstance> m_pSolidMaterialInstance_DEPRECATED = nullptr;
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Use Gazeous Material Instance (Streamed) instead"))
+	TObjectPtr<UMaterialInstance> m_pGazeousMaterialInstance_DEPRECATED = nullptr;
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Use Liquid Skeletal Mesh Instance (Streamed) instead"))
+	TObjectPtr<USkeletalMesh> m_pLiquidSKInstance_DEPRECATED = nullptr;
+	UPROPERTY(meta = (DeprecatedProperty, DeprecationMessage = "Use Solid Skeletal Mesh Instance (Streamed) instead"))
+	TObjectPtr<USkeletalMesh> m_pSolidSKInstance_DEPRECATED = nullptr;
+
+	/** Use one dynamic material instance for every state and only push the state's parameters to it instead of swapping material instances */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Materials", meta = (DisplayName = "Use Blended State Material"))
+	bool m_bUseBlendedStateMaterial = false;
+	/** Material the blended state material is created from */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Materials", meta = (DisplayName = "Blended State Base Material", EditCondition = "m_bUseBlendedStateMaterial"))
+	class UMaterialInterface* m_pBlendedStateBaseMaterial = nullptr;
+	/** Blend the parameters over the state change transition duration instead of applying them at once */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Materials", meta = (DisplayName = "Blend State Material Parameters", EditCondition = "m_bUseBlendedStateMaterial"))
+	bool m_bBlendStateMaterialParameters = true;
+	/** Liquid parameters of the blended state material */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Materials", meta = (DisplayName = "Liquid Material Parameters", EditCondition = "m_bUseBlendedStateMaterial"))
+	FDropletMaterialStateParameters m_LiquidMaterialParameters;
+	/** Solid parameters of the blended state material */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Materials", meta = (DisplayName = "Solid Material Parameters", EditCondition = "m_bUseBlendedStateMaterial"))
+	FDropletMaterialStateParameters m_SolidMaterialParameters;
+	/** Gazeous parameters of the blended state material */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Materials", meta = (DisplayName = "Gazeous Material Parameters", EditCondition = "m_bUseBlendedStateMaterial"))
+	FDropletMaterialStateParameters m_GazeousMaterialParameters;
+
+	/** Prepare the render resources of every state's mesh and material while loading, and apply a state's mesh, material and visibility in a single render state update. Off until a PSO hitch capture shows it helps */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DropletPlayerCharacter|Materials", meta = (DisplayName = "Use Prewarmed State Transitions"))
+	bool m_bUsePrewarmedStateTransitions = false;
 
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Speed", meta = (DisplayName = "Oil Speed Factor"))
 	float m_fOilSpeedFactor = 0.5f;
 
+	/** Size of a replay chunk in bytes, every chunk starts with a keyframe */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Replay", meta = (DisplayName = "Replay Max Chunk Bytes", ClampMin = "256"))
+	int32 m_iReplayMaxChunkBytes = 64 * 1024;
+	/** Max number of replay chunks kept in memory, the oldest is dropped in ring mode, else the recording stops */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Replay", meta = (DisplayName = "Replay Max Chunk Count", ClampMin = "1"))
+	int32 m_iReplayMaxChunkCount = 64;
+	/** Number of frames between two transform and velocity keyframes of the replay */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Replay", meta = (DisplayName = "Replay Keyframe Interval", ClampMin = "1"))
+	int32 m_iReplayKeyframeInterval = 30;
+	/** Snap the character back on the replay keyframes when the playback drifted from the recording */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DropletPlayerCharacter|Replay", meta = (DisplayName = "Correct Replay Drift"))
+	bool m_bCorrectReplayDrift = true;
+	/** Distance to the keyframe location over which the playback is snapped back, in cm */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DropletPlayerCharacter|Replay", meta = (DisplayName = "Replay Drift Tolerance", EditCondition = "m_bCorrectReplayDrift"))
+	float m_fReplayDriftTolerance = 10.f;
+
 public:
 	ADropletPlayerCharacter();
 
 	/** Called when the game starts or when spawned */
 	virtual void BeginPlay() override;
 
+	/** Called after the character is loaded, to move the deprecated hard asset references to the streamed ones */
+	virtual void PostLoad() override;
+
+	/** Called when the game ends or when destroyed */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	/** Called every frame */
 	virtual void Tick(float fDeltaTime) override;
 
@@ -235,11 +600,76 @@ public:
 	/** Perform special action on landing */
 	virtual void Landed(const FHitResult& Hit) override;
 
+	/** Called when the character has been teleported */
+	virtual void TeleportSucceeded(bool bIsATest) override;
+
 	// ----------------------------------- Getters and Setters ------------------------------------------------------------
 
 	float GetMaxSlopeAngle() const { return m_fMaxSlopeAngle; }
 	float GetStepSlopeAngle() const { return m_fStepSlopeAngle; }
 
+	/** Returns the StaminaComponent of the current MaterialState */
+	UStaminaComponent* GetStaminaComponent() const;
+
+	/** Called to switch the ground sensing mode at runtime */
+	UFUNCTION(BlueprintCallable, Category = "DropletPlayerCharacter|SlopeDetection")
+	void SetGroundSensingMode(EDropletGroundSensingMode eNewMode);
+
+	/** Returns the ratio of ground probe requests served by the cache instead of tracing the ring */
+	UFUNCTION(BlueprintCallable, Category = "DropletPlayerCharacter|SlopeDetection")
+	float GetGroundProbeCacheHitRate() const;
+
+	/**
+	 * Console command starting to record the per frame cost of the benchmark sections,
+	 * driving the character with the benchmark input script if bRunScript is set.
+	 * The benchmark commands do nothing in Shipping builds
+	 */
+	UFUNCTION(Exec)
+	void DropletBenchmarkStart(int32 bRunScript = 1);
+
+	/** Console command stopping the benchmark and logging the percentiles of each section */
+	UFUNCTION(Exec)
+	void DropletBenchmarkStop();
+
+	/**
+	 * Console command running the benchmark input script for fDuration seconds then logging the percentiles,
+	 * exiting afterwards if bQuitWhenDone is set (for -nullrhi -ExecCmds runs on build agents)
+	 */
+	UFUNCTION(Exec)
+	void DropletBenchmarkRun(float fDuration = 30.f, int32 bQuitWhenDone = 0);
+
+#if !UE_BUILD_SHIPPING
+	/** Returns the frames recorded for a benchmark section by the last benchmark run */
+	const FDropletCostSampler& GetBenchmarkResults(EDropletBenchmarkSection eSection) const { return m_BenchmarkSamplers[static_cast<uint8>(eSection)]; }
+
+	/** Returns true while the benchmark records */
+	bool IsBenchmarkRecording() const { return m_bIsBenchmarkRecording; }
+#endif
+
+	/** Console command starting to record the droplet input, state changes and keyframes, keeping only the last chunks if bRingMode is set */
+	UFUNCTION(Exec)
+	void DropletReplayRecord(int32 bRingMode = 0);
+
+	/**
+	 * Console command stopping the replay recording and saving it in Saved/Replays on a background thread,
+	 * or stopping the replay playback
+	 */
+	UFUNCTION(Exec)
+	void DropletReplayStop(const FString& FileName = TEXT(""));
+
+	/** Console command driving the character with the input of a replay file of Saved/Replays */
+	UFUNCTION(Exec)
+	void DropletReplayPlay(const FString& FileName);
+
+	/** Called to drop the cached ground probe, the next ground query traces the ring again */
+	void InvalidateGroundProbeCache();
+
+	/** Called to reset the ground probe cache hit and miss counters */
+	void ResetGroundProbeCacheStats();
+
+	/** Called to rebuild the line trace Query Parameters on the next trace, e.g. after attaching actors to the character */
+	void MarkIgnoreCharacterQueryParamsDirty() { m_bIsIgnoreCharacterQueryParamsDirty = true; }
+
 	TObjectPtr<USphereComponent> GetInteractableRangeSphereComponent() const { return pInteractableRangeSphereComponent; }
 
 #pragma region InteractableMarkers
@@ -276,6 +706,13 @@ public:
 	// Clear the array of Interactable markers
 	void ClearInteractableMarkers();
 
+	// Rebuild the marker mask from the array of Interactable markers, which Blueprints can edit
+	void RefreshInteractableMarkerMask() const;
+
+	// Number of interactable marker types with a TDropletInteractableMarkerBit
+	static constexpr int32 InteractableMarkerTypeCount = FDropletInteractableMarkerTypes::Count;
+	static_assert(InteractableMarkerTypeCount <= 8, "m_uiInteractableMarkerMask has one bit per marker type");
+
 	// Called to display the interaction button
 	void DisplayInteractionButton();
 
@@ -288,47 +725,228 @@ protected:
 	/** Called for movement input */
 	virtual void Move(const FInputActionValue& Value) override;
 
+	/** Called to execute the current MaterialState's move function through the native or the reflected path */
+	void DispatchMove(const FInputActionValue& Value);
+
 	/** Called for jump input */
 	virtual void Jump() override;
 
+	/** Called for jump input release */
+	virtual void StopJumping() override;
+
 	/** Called for interaction input */
 	virtual void Interact();
 
 	/** Called to handle interaction action display */
 	virtual void HandleInteractionButtonDisplay();
 
+	/** Called when an actor starts overlapping the interactable range sphere */
+	UFUNCTION()
+	void OnInteractableRangeBeginOverlap(UPrimitiveComponent* pOverlappedComponent, AActor* pOtherActor, UPrimitiveComponent* pOtherComponent, int32 iOtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+
+	/** Called when an actor stops overlapping the interactable range sphere */
+	UFUNCTION()
+	void OnInteractableRangeEndOverlap(UPrimitiveComponent* pOverlappedComponent, AActor* pOtherActor, UPrimitiveComponent* pOtherComponent, int32 iOtherBodyIndex);
+
+	/** Called to track an actor entering the interactable range if we can interact with it */
+	void AddInteractableCandidate(AActor* pActor);
+
+	/** Called to select the interactable target among the candidates, at most once per frame */
+	void UpdateInteractableSelection();
+
+	/** Called to unregister the character from the interactable component it is registered to */
+	void FlushInteractableRegistration();
+
+	/** Called to forget the candidates destroyed since they entered the interactable range */
+	void PruneInteractableCandidates();
+
+	/** Called to check if the root component of a candidate overlaps the interactable range sphere */
+	bool IsInteractableCandidateRootOverlapping(const FDropletInteractableCandidate& candidate) const;
+
 	/** Called for changing the material state */
 	virtual void ChangeMaterialState(const FInputActionValue& Value);
 
+#if !UE_BUILD_SHIPPING
+	/** Called every frame while the benchmark input script runs to send it the scripted input */
+	void UpdateBenchmarkScript(float fDeltaTime);
+#endif
+
+	/** Called for every trace the character fires, to count them in the stats and in the CSV metrics */
+	void CountIssuedTrace() const;
+
+	/** Called every frame to record the droplet metrics in CSV profiler captures when droplet.CsvStats is set */
+	void RecordCsvStats() const;
+
+#if !UE_BUILD_SHIPPING
+	/** Returns the sampler of a benchmark section while the benchmark records, else nullptr */
+	FDropletCostSampler* GetBenchmarkSampler(EDropletBenchmarkSection eSection) const;
+#endif
+
+	/** Called at the start of the Tick while a replay plays to send the character the input of its next frame */
+	void UpdateReplayPlayback();
+
+	/** Called on the first frame of a replay to enter its recorded MaterialState and end the splash or slide dash it wasn't in */
+	void ApplyReplayStartState(const FDropletReplayFrame& frame);
+
+	/** Called at the end of the Tick to record the replay frame and check the playback against the replay keyframe */
+	void EndReplayFrame(float fDeltaTime);
+
+	/** Returns true if the input comes from the player while a replay drives the character, it is ignored */
+	bool IsInputOverriddenByReplay() const { return m_pReplayPlayer.IsValid() && !m_bIsApplyingReplayInput; }
+
 	/** Called when possession is gained */
 	virtual void PossessedBy(AController* pNewController) override;
 
+	/** Called when the pawn is restarted on the owning client, keeps the current state's mapping context the only droplet one */
+	virtual void PawnClientRestart() override;
+
 	/** Called to perform the splash action */
 	virtual void Splash(const FHitResult& Hit);
 
+	/** Called by the movement to get the splash velocity of a movement step, returns false once the splash is over */
+	bool ComputeSplashVelocity(float fDeltaTime, FVector& vOutVelocity);
+
+	/** Called to end the splash */
+	void EndSplash();
+
+	/** Called by the movement to get the slide dash velocity of a movement step, returns false once the slide dash is over */
+	bool ComputeSlideDashVelocity(float fDeltaTime, const FVector& vCurrentVelocity, FVector& vOutVelocity);
+
+	/** Returns the max falling speed of the SpeedComponent, 0 if there is none */
+	float GetMaxFallSpeed() const;
+
 	/** Called to change the input mapping context to the material state's corresponding one */
 	void ChangeInputMappingContext(EDropletMaterialState eNewMaterialState);
 
+	/** Returns the input mapping context of a MaterialState, the default one for the none state */
+	class UInputMappingContext* GetMaterialStateMappingContext(EDropletMaterialState eMaterialState) const;
+
 	/** Called to change the skeletal mesh to the material state's one */
 	void ChangeSkeletalMeshInstance(EDropletMaterialState eNewMaterialState);
 
+	/** Called to start streaming in the streamed meshes and materials of a MaterialState */
+	void RequestMaterialStateAssets(EDropletMaterialState eMaterialState);
+
+	/** Called to make sure the streamed meshes and materials of a MaterialState are loaded before switching to it */
+	void EnsureMaterialStateAssetsResident(EDropletMaterialState eMaterialState);
+
+	/** Called on memory pressure to release the streamed assets of the MaterialStates we are not in */
+	void OnMemoryTrim();
+
+	/** Called when the streamed meshes and materials of a MaterialState finished loading */
+	void OnMaterialStateAssetsLoaded(EDropletMaterialState eMaterialState);
+
+	/** Called to prepare the render resources (PSOs) of a MaterialState's mesh and material before it is first shown */
+	void PrewarmMaterialStateRenderResources(EDropletMaterialState eMaterialState);
+
+	/** Called to destroy the state warm up components once their pipeline states are compiled */
+	void ReleaseMaterialStateWarmUpComponents();
+
+	/** Called to apply the mesh, material and visibility of a MaterialState in a single render state update */
+	void ApplyMaterialStateRenderChanges(EDropletMaterialState eNewMaterialState);
+
+	/** Called to create the blended state material and assign it to the mesh */
+	void CreateBlendedStateMaterial();
+
+	/** Called to start pushing a MaterialState's parameters to the blended state material */
+	void BeginStateMaterialBlend(EDropletMaterialState eNewMaterialState);
+
+	/** Called every frame to push the blended parameters until the blend is over */
+	void UpdateStateMaterialBlend(float fDeltaTime);
+
+	/** Returns the streamed asset, loading it now if its stream request didn't complete yet, or nullptr if it is not set */
+	template <typename T>
+	static T* ResolveMaterialStateAsset(const TSoftObjectPtr<T>& softAsset) { return softAsset.IsNull() ? nullptr : softAsset.LoadSynchronous(); }
+
 	/** Called to change the material instance of the mesh */
 	void ChangeMeshMaterialInstance(EDropletMaterialState eNewMaterialState);
 
-	/** Called to change the StaminaComponent */
+	/** Called to activate the MaterialState's StaminaComponent instead of the current one and hand over the stamina */
 	void ChangeStaminaComponent(EDropletMaterialState eNewMaterialState);
 
+	/** Returns the StaminaComponent class of a MaterialState, indexed by GetMaterialStateIndex */
+	TSubclassOf<UStaminaComponent> GetMaterialStateStaminaComponentClass(int32 iStateIndex) const;
+
+	/** Called to create the StaminaComponent of every MaterialState once, inactive and hidden from the component lookups */
+	void CreateStaminaComponents();
+
+	/** Called to activate a state's StaminaComponent and give it to the character, or to deactivate it and take it away from the character */
+	void SetStaminaComponentActive(UStaminaComponent* pStaminaComponent, bool bIsActive);
+
+	/** Called to check that the cached component handles match the real components */
+	void VerifyComponentHandles() const;
+
+	/** Returns the index of a MaterialState in the per state arrays, INDEX_NONE for the none state */
+	static int32 GetMaterialStateIndex(EDropletMaterialState eMaterialState);
+
+	// Number of MaterialStates with a per state entry (liquid, solid and gazeous)
+	static constexpr int32 MaterialStateCount = 3;
+
 	/** Called to apply the MaterialState corresponding SpeedComponent values */
 	void ApplySpeedComponentStateValues(EDropletMaterialState eNewMaterialState);
 
 	/** Called to apply the MaterialState corresponding duration values */
 	void ApplyMaterialStateDurationAndCooldown(EDropletMaterialState eNewMaterialState);
 
+	/** Called to bake the splash and slide dash speed curves of the SpeedComponent into lookup tables */
+	void BakeSpeedCurves();
+
+	/** Called to gather the per MaterialState values of the character and the SpeedComponent into the MaterialState records */
+	void BuildMaterialStateRecords();
+
+	/** Returns the record of the current MaterialState, a record without ground speeds for the none state */
+	const FDropletMaterialStateRecord& GetCurrentMaterialStateRecord() const;
+
 	/** Called to get a hit result under the character */
 	virtual bool GetHitLineTracedUnder(FHitResult& Hit, FVector vOffset = FVector::ZeroVector, float fOvverideLineTraceVLength = -1.f) const;
 
-	/** Called to get the Query Parameters to ignore Character in line trace */
-	virtual FCollisionQueryParams GetIgnoreCharacterLineTraceQueryParams() const;
+	/** Called to get the Query Parameters to ignore Character in line trace, built once and rebuilt when the child actors change */
+	virtual const FCollisionQueryParams& GetIgnoreCharacterLineTraceQueryParams() const;
+
+	/** Called when an actor is spawned in the world, to rebuild the Query Parameters if it is one of the character's child actors */
+	void OnWorldActorSpawned(AActor* pActor);
+
+	/** Called when an actor of the world is destroyed, to rebuild the Query Parameters if it is one of the character's child actors */
+	void OnWorldActorDestroyed(AActor* pActor);
+
+	/** Returns true if the actor is a child actor of the character, directly or through other child actors */
+	bool IsChildActorOfCharacter(const AActor* pActor) const;
+
+	/** Called to get the ground probe of the current frame, the probe ring is fired at most once per frame */
+	const FDropletGroundProbe& GetGroundProbe() const;
+
+	/** Called to fire the probe ring under the character and vote the slope of the ground probe */
+	virtual void UpdateGroundProbe() const;
+
+	/** Called to fill the samples of a ground probe with the given ground sensing mode */
+	void FillGroundProbe(FDropletGroundProbe& groundProbe, EDropletGroundSensingMode eMode, bool bCanConsumeAsync) const;
+
+	/** Called to fill the samples of a ground probe with the hits of one sphere sweep and the movement component's CurrentFloor */
+	void SweepGroundProbe(FDropletGroundProbe& groundProbe) const;
+
+	/** Called to vote the slope angle and global slope normal of a ground probe from its samples */
+	void VoteGroundProbe(FDropletGroundProbe& groundProbe, bool bDrawDebug) const;
+
+	/** Called to average the cost of a ground sensing mode */
+	void RecordGroundSensingCost(EDropletGroundSensingMode eMode, uint64 uiCycles) const;
+
+	/** Called to run the other ground sensing mode and measure its disagreement with the current one */
+	void CompareGroundSensingModes() const;
+
+	/** Called to get the offset of a probe of the ring from the capsule center */
+	FVector GetGroundProbeOffset(int32 iProbeIndex) const;
+
+	/** Called to submit the probe ring with async traces, their results are consumed on the next frame */
+	void SubmitAsyncGroundProbe();
+
+	/** Called to fill the ground probe with the async traces submitted on the previous frame, returns false if they can't be used */
+	bool ConsumeAsyncGroundProbe(FDropletGroundProbe& groundProbe) const;
+
+	/** Called to check if the cached ground probe still describes the ground under the capsule */
+	bool IsGroundProbeCacheValid() const;
+
+	/** Called to key the ground probe cache on the primitive and location the ring was fired from */
+	void StoreGroundProbeCache() const;
 
 protected:
 	// Cached speed component
@@ -351,10 +969,95 @@ protected:
 	UPROPERTY(BlueprintReadOnly, Category = "SpeedComponent", meta = (DisplayName = "Just Changed State"))
 	bool m_bJustChangedState = false;
 
-	// InteractableMarkers array
+	// InteractableMarkers array, m_uiInteractableMarkerMask is rebuilt from it before every marker query so Blueprint edits are taken into account
 	UPROPERTY(BlueprintReadWrite, Category = "InteractableMarkers", meta = (DisplayName = "Interactable Markers Array"))
 	TArray<UInteractableMarker*> m_InteractableMarkers;
 
+	// One marker instance per marker type, created once and reused by AddInteractableMarker
+	UPROPERTY()
+	TArray<TObjectPtr<UInteractableMarker>> m_InteractableMarkerPool;
+
+	// Streaming handles of the streamed meshes and materials of each MaterialState, indexed by GetMaterialStateIndex
+	TSharedPtr<struct FStreamableHandle> m_MaterialStateAssetsHandles[MaterialStateCount];
+	// MaterialState whose streamed assets must stay resident
+	EDropletMaterialState m_eResidentMaterialState = EDropletMaterialState::EDropletMaterialState_None;
+	// Whether the render resources of each MaterialState were prepared, indexed by GetMaterialStateIndex
+	bool m_bIsMaterialStatePrewarmed[MaterialStateCount] = { false, false, false };
+	// Hidden components registered with a state's mesh and material while their pipeline states compile
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<USkeletalMeshComponent>> m_MaterialStateWarmUpComponents;
+	// Game thread cost of the last mesh and material swap in ms
+	float m_fLastStateTransitionGameThreadMs = 0.f;
+
+	// EnhancedInputLocalPlayerSubsystem of the possessing player, resolved once on possession
+	TWeakObjectPtr<class UEnhancedInputLocalPlayerSubsystem> m_pEnhancedInputSubsystem;
+
+	// Dynamic material instance shared by every state in the blended state material mode
+	UPROPERTY()
+	TObjectPtr<UMaterialInstanceDynamic> m_pBlendedStateMaterial = nullptr;
+	// Parameters last pushed to the blended state material
+	FDropletMaterialStateParameters m_StateMaterialCurrentParameters;
+	// Parameters when the current blend started
+	FDropletMaterialStateParameters m_StateMaterialBlendFromParameters;
+	// Parameters the current blend goes to, nullptr when not blending
+	const FDropletMaterialStateParameters* m_pStateMaterialBlendToParameters = nullptr;
+	// Time elapsed since the current blend started in seconds
+	float m_fStateMaterialBlendElapsedTime = 0.f;
+
+	// Cached StaminaComponent of the character
+	mutable TDropletComponentHandle<UStaminaComponent> m_StaminaComponentHandle;
+	// StaminaComponent of each MaterialState, indexed by GetMaterialStateIndex, only the current state's one is active and owned by the character
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UStaminaComponent>> m_StaminaComponentPool;
+
+	// Number of traces fired during m_uiIssuedTraceCountFrame
+	mutable uint32 m_uiIssuedTraceCount = 0;
+	// Frame the traces were counted on
+	mutable uint64 m_uiIssuedTraceCountFrame = MAX_uint64;
+
+#if !UE_BUILD_SHIPPING
+	// Per frame cost of each benchmark section
+	mutable FDropletCostSampler m_BenchmarkSamplers[static_cast<uint8>(EDropletBenchmarkSection::EDropletBenchmarkSection_Count)];
+	// Whether the benchmark records the cost of the sections
+	bool m_bIsBenchmarkRecording = false;
+	// Whether the benchmark input script drives the character
+	bool m_bIsBenchmarkScriptRunning = false;
+	// Whether to exit once the benchmark run is over
+	bool m_bQuitWhenBenchmarkDone = false;
+	// Time since the benchmark started in seconds
+	float m_fBenchmarkElapsedTime = 0.f;
+	// Duration of the benchmark run in seconds, 0 to run until DropletBenchmarkStop
+	float m_fBenchmarkDuration = 0.f;
+#endif
+
+	// Replay being recorded, nullptr when not recording
+	TUniquePtr<FDropletReplayRecorder> m_pReplayRecorder;
+	// Replay being played, nullptr when not playing
+	TUniquePtr<FDropletReplayPlayer> m_pReplayPlayer;
+	// Frame of the replay played this Tick
+	FDropletReplayFrame m_CurrentReplayFrame;
+	// Whether the input is sent by the replay playback
+	bool m_bIsApplyingReplayInput = false;
+	// Whether the replay frame played this Tick is the first one
+	bool m_bIsReplayStarting = false;
+
+	// Baked SpeedComponent splash speed boost curve
+	FDropletBakedCurve m_SplashSpeedBoostCurve;
+	// Baked SpeedComponent liquid to solid (slide dash) speed boost curve
+	FDropletBakedCurve m_LiquidToSolidSpeedBoostCurve;
+
+	// Per MaterialState values, indexed by GetMaterialStateIndex, rebuilt on state change
+	FDropletMaterialStateRecord m_MaterialStateRecords[MaterialStateCount];
+	// Index of the current MaterialState in the per state arrays, INDEX_NONE for the none state
+	int32 m_iCurrentMaterialStateIndex = INDEX_NONE;
+
+	// Bit per marker type present in m_InteractableMarkers, indexed by TDropletInteractableMarkerBit
+	mutable uint8 m_uiInteractableMarkerMask = 0;
+
+	// Template function to get the pooled marker of a type, created on first use
+	template <typename T>
+	UInteractableMarker* GetPooledInteractableMarker();
+
 	UPROPERTY(BlueprintReadWrite, Category = "SpeedComponent", meta = (DisplayName = "Is Under Oil Effect"))
 	bool m_bIsUnderOilEffect;
 
@@ -364,8 +1067,68 @@ private:
 	/** Changes the movement function depending on the DropletPlayerController MaterialState by binding it to a new function */
 	FMoveFunction m_MoveFunction;
 
+	/** MaterialState description of the current MaterialState, the move function is called on it directly */
+	UPROPERTY()
+	TObjectPtr<UDropletMaterialStateDescription> m_pCurrentMaterialStateDescription = nullptr;
+	// Whether the current state's class resolves the move function to the UDropletMaterialStateDescription one
+	bool m_bIsNativeMoveDispatchSafe = false;
+
 	float m_fTargetMaxSpeed = -1.f;
 
+	// Ground probe shared by GetSlopeAngle, IsAscending and IsOnFlat during a frame
+	mutable FDropletGroundProbe m_GroundProbe;
+
+	// Async trace handles of the probe ring submitted on m_uiAsyncGroundProbeSubmitFrame
+	FTraceHandle m_AsyncGroundProbeHandles[FDropletGroundProbe::ProbeCount];
+	// Frame on which the async probe ring was submitted
+	uint64 m_uiAsyncGroundProbeSubmitFrame = MAX_uint64;
+
+	// Hits of the ground sweep, kept to reuse the allocation
+	mutable TArray<FHitResult> m_GroundSweepHits;
+
+	// Ground sensing comparison values ---------------------------------------------
+
+	// Average cost of each ground sensing mode in ms
+	mutable float m_fGroundSensingAverageCostMs[static_cast<uint8>(EDropletGroundSensingMode::EDropletGroundSensingMode_Count)] = {};
+	// Average and max slope angle difference between the ground sensing modes
+	mutable float m_fGroundSensingAverageAngleError = 0.f;
+	mutable float m_fGroundSensingMaxAngleError = 0.f;
+	// Number of comparisons and of comparisons which disagreed on the ground being flat
+	mutable uint32 m_uiGroundSensingComparisonCount = 0;
+	mutable uint32 m_uiGroundSensingFlatVoteMismatchCount = 0;
+
+	// Interactable actors in range of the interactable range sphere, kept up to date by its overlap events
+	TArray<FDropletInteractableCandidate> m_InteractableCandidates;
+	// Active interactable component selected as target
+	TWeakObjectPtr<UInputInteractableActorComponent> m_pSelectedInteractable;
+	// Nearest interactable component in range, active or not
+	TWeakObjectPtr<UInputInteractableActorComponent> m_pNearestInteractable;
+	// Frame on which the interactable target was selected
+	uint64 m_uiInteractableSelectionFrame = MAX_uint64;
+	// Interactable component the character is currently registered to
+	TWeakObjectPtr<UInputInteractableActorComponent> m_pRegisteredInteractable;
+
+	// Line trace Query Parameters ignoring the character and its child actors
+	mutable FCollisionQueryParams m_IgnoreCharacterQueryParams;
+	// Whether the Query Parameters have to be rebuilt before the next trace
+	mutable bool m_bIsIgnoreCharacterQueryParamsDirty = true;
+	// World notifications the child actors are tracked with
+	FDelegateHandle m_ActorSpawnedHandle;
+	FDelegateHandle m_ActorDestroyedHandle;
+
+	// Ground probe cache values --------------------------------------------------
+
+	// Whether the ground probe can be reused on the next frames
+	mutable bool m_bIsGroundProbeCacheValid = false;
+	// Capsule location the cached probe ring was fired from
+	mutable FVector m_vGroundProbeCacheLocation = FVector::ZeroVector;
+	// Static primitive hit by every probe of the cached ring
+	mutable TWeakObjectPtr<UPrimitiveComponent> m_pGroundProbeCachePrimitive;
+	// Number of ground probe requests served by the cache
+	mutable uint32 m_uiGroundProbeCacheHits = 0;
+	// Number of ground probe requests which had to fire the ring
+	mutable uint32 m_uiGroundProbeCacheMisses = 0;
+
 
 
 	// State transition speed boost values ---------------------------------------
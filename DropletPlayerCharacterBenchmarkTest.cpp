@@ -0,0 +1,272 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Player/DropletPlayerCharacter.h"
+#include "DropletPlayerController.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Components/Interactables/InputInteractableActorComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/GameModeBase.h"
+#include "Misc/ScopeExit.h"
+
+
+namespace DropletBenchmarkTest
+{
+	// Frame time the test world is ticked with
+	constexpr float DeltaTime = 1.f / 60.f;
+	// Number of frames the benchmark input script drives the character, long enough for every scripted input to repeat
+	constexpr int32 FrameCount = 600;
+	// Number of frames the character is given to land after being placed
+	constexpr int32 LandingFrameCount = 120;
+	// Pitch of the ramp, in degrees
+	constexpr float RampPitch = 20.f;
+
+	/** Benchmark section reported by the test */
+	struct FSectionReport
+	{
+		EDropletBenchmarkSection eSection;
+		const TCHAR* Name;
+		// Whether the section must run during the benchmark
+		bool bIsRequired;
+	};
+
+	static const FSectionReport SectionReports[] =
+	{
+		{ EDropletBenchmarkSection::EDropletBenchmarkSection_Tick, TEXT("Tick"), true },
+		{ EDropletBenchmarkSection::EDropletBenchmarkSection_GetSlopeAngle, TEXT("GetSlopeAngle"), true },
+		{ EDropletBenchmarkSection::EDropletBenchmarkSection_HandleInteractionButtonDisplay, TEXT("HandleInteractionButtonDisplay"), false },
+		{ EDropletBenchmarkSection::EDropletBenchmarkSection_SetMaterialState, TEXT("SetMaterialState"), true },
+	};
+	static_assert(UE_ARRAY_COUNT(SectionReports) == static_cast<uint8>(EDropletBenchmarkSection::EDropletBenchmarkSection_Count), "One report per benchmark section");
+
+	/** Spawns a blocking box scaled from the engine's 1m cube */
+	static AStaticMeshActor* SpawnBlock(UWorld* pWorld, UStaticMesh* pCubeMesh, const FVector& vLocation, const FRotator& rRotation, const FVector& vScale)
+	{
+		AStaticMeshActor* pBlock = pWorld->SpawnActor<AStaticMeshActor>(vLocation, rRotation);
+		if (pBlock == nullptr)
+		{
+			return nullptr;
+		}
+
+		UStaticMeshComponent* pMeshComponent = pBlock->GetStaticMeshComponent();
+		pMeshComponent->SetMobility(EComponentMobility::Movable);
+		pMeshComponent->SetStaticMesh(pCubeMesh);
+		pMeshComponent->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+		pBlock->SetActorScale3D(vScale);
+
+		return pBlock;
+	}
+
+	/** Ticks the world, advancing the frame counter the samplers split the frames on as the engine loop would */
+	static void TickFrames(UWorld* pWorld, int32 iFrameCount)
+	{
+		for (int32 i = 0; i < iFrameCount; ++i)
+		{
+			pWorld->Tick(LEVELTICK_All, DeltaTime);
+			++GFrameCounter;
+		}
+	}
+
+	/** Places the character above a location and ticks until it lands, returns whether it did */
+	static bool DropCharacterAt(UWorld* pWorld, ADropletPlayerCharacter* pCharacter, const FVector& vGroundLocation)
+	{
+		const float fHalfHeight = pCharacter->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+		pCharacter->SetActorLocation(vGroundLocation + FVector(0.f, 0.f, fHalfHeight + 50.f), false, nullptr, ETeleportType::TeleportPhysics);
+		pCharacter->GetCharacterMovement()->Velocity = FVector::ZeroVector;
+
+		for (int32 i = 0; i < LandingFrameCount && !pCharacter->GetCharacterMovement()->IsMovingOnGround(); ++i)
+		{
+			TickFrames(pWorld, 1);
+		}
+
+		return pCharacter->GetCharacterMovement()->IsMovingOnGround();
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDropletPlayerCharacterBenchmarkTest, "Droplet.Performance.PlayerCharacterBenchmark", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FDropletPlayerCharacterBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace DropletBenchmarkTest;
+
+	// The character and controller classes come from the project's game mode, their Blueprints set up the material state descriptions
+	UWorld* pWorld = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& worldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	worldContext.SetCurrentWorld(pWorld);
+
+	ON_SCOPE_EXIT
+	{
+		GEngine->DestroyWorldContext(pWorld);
+		pWorld->DestroyWorld(false);
+	};
+
+	pWorld->SetGameMode(FURL());
+	pWorld->InitializeActorsForPlay(FURL());
+
+	const AGameModeBase* pGameMode = pWorld->GetAuthGameMode();
+	if (!TestNotNull(TEXT("Game mode"), pGameMode))
+	{
+		return false;
+	}
+
+	UClass* pCharacterClass = pGameMode->DefaultPawnClass;
+	UClass* pControllerClass = pGameMode->PlayerControllerClass;
+	if (!TestTrue(TEXT("Default pawn class is a droplet character"), pCharacterClass != nullptr && pCharacterClass->IsChildOf<ADropletPlayerCharacter>()) ||
+		!TestTrue(TEXT("Player controller class is a droplet controller"), pControllerClass != nullptr && pControllerClass->IsChildOf<ADropletPlayerController>()))
+	{
+		return false;
+	}
+
+	// Ground the character goes over: a floor, a ramp, stairs and an interactable next to the path
+	UStaticMesh* pCubeMesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	if (!TestNotNull(TEXT("Engine cube mesh"), pCubeMesh))
+	{
+		return false;
+	}
+
+	const FVector vFloorStart(0.f, 0.f, 0.f);
+	const FVector vRampCenter(1200.f, 0.f, 0.f);
+
+	SpawnBlock(pWorld, pCubeMesh, FVector(2000.f, 0.f, -50.f), FRotator::ZeroRotator, FVector(60.f, 20.f, 1.f));
+	SpawnBlock(pWorld, pCubeMesh, vRampCenter, FRotator(RampPitch, 0.f, 0.f), FVector(8.f, 6.f, 0.5f));
+
+	for (int32 i = 0; i < 6; ++i)
+	{
+		const float fStepHeight = 20.f * (i + 1);
+		SpawnBlock(pWorld, pCubeMesh, FVector(2200.f + 40.f * i, 0.f, fStepHeight * 0.5f), FRotator::ZeroRotator, FVector(0.4f, 6.f, fStepHeight / 100.f));
+	}
+
+	if (AStaticMeshActor* pInteractable = SpawnBlock(pWorld, pCubeMesh, FVector(600.f, 200.f, 50.f), FRotator::ZeroRotator, FVector(0.5f)))
+	{
+		// The character registers the interactables its range sphere overlaps
+		pInteractable->GetStaticMeshComponent()->SetGenerateOverlapEvents(true);
+
+		UInputInteractableActorComponent* pInteractableComponent = NewObject<UInputInteractableActorComponent>(pInteractable);
+		pInteractableComponent->RegisterComponent();
+	}
+
+	pWorld->BeginPlay();
+
+	FActorSpawnParameters spawnParameters;
+	spawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	ADropletPlayerController* pController = pWorld->SpawnActor<ADropletPlayerController>(pControllerClass, FVector::ZeroVector, FRotator::ZeroRotator, spawnParameters);
+	ADropletPlayerCharacter* pCharacter = pWorld->SpawnActor<ADropletPlayerCharacter>(pCharacterClass, vFloorStart + FVector(0.f, 0.f, 200.f), FRotator::ZeroRotator, spawnParameters);
+	if (!TestNotNull(TEXT("Spawned droplet controller"), pController) || !TestNotNull(TEXT("Spawned droplet character"), pCharacter))
+	{
+		return false;
+	}
+
+	// The controller has no local player in this world, so there is no input subsystem to register the mapping contexts to
+	AddExpectedError(TEXT("EnhancedInputLocalPlayerSubsystem is nullptr"), EAutomationExpectedErrorFlags::Contains, 0);
+
+	pController->Possess(pCharacter);
+
+	TObjectPtr<UDropletMaterialStateDescription> pInitialStateDescription = UDropletMaterialStateDescription::GetMaterialStateDescriptionFromState(pController->GetMaterialState());
+	if (!TestNotNull(TEXT("Material state description of the initial state"), pInitialStateDescription.Get()))
+	{
+		return false;
+	}
+
+	// The character lands on the floor
+	TestTrue(TEXT("Character grounded on the floor"), DropCharacterAt(pWorld, pCharacter, vFloorStart));
+
+	// The slope is sensed on the ramp
+	if (TestTrue(TEXT("Character grounded on the ramp"), DropCharacterAt(pWorld, pCharacter, vRampCenter)))
+	{
+		FHitResult hit;
+		FVector vSlopeNormal;
+		const float fSlopeAngle = pCharacter->GetSlopeAngle(hit, vSlopeNormal);
+
+		AddInfo(FString::Printf(TEXT("Slope angle on the %.1f degrees ramp: %.2f"), RampPitch, fSlopeAngle));
+		TestTrue(TEXT("Non zero slope angle on the ramp"), !FMath::IsNearlyZero(fSlopeAngle, 1.f));
+	}
+
+	// The material state changes
+	const EDropletMaterialState eInitialMaterialState = pController->GetMaterialState();
+	pController->PlayerChangeMaterialState(false);
+	TickFrames(pWorld, 1);
+	TestTrue(TEXT("Material state changed"), pController->GetMaterialState() != eInitialMaterialState);
+
+	// Run the benchmark input script from the start of the floor
+	DropCharacterAt(pWorld, pCharacter, vFloorStart);
+
+	pCharacter->DropletBenchmarkStart(1);
+	TickFrames(pWorld, FrameCount);
+	pCharacter->DropletBenchmarkStop();
+
+	// Wall clock time depends on the machine, the percentiles are reported rather than checked against a budget
+	for (const FSectionReport& report : SectionReports)
+	{
+		const FDropletCostSampler& sampler = pCharacter->GetBenchmarkResults(report.eSection);
+
+		AddInfo(FString::Printf(TEXT("%s frames=%d p50=%.4f p90=%.4f p99=%.4f max=%.4f ms"), report.Name, sampler.FrameCostsMs.Num(),
+			sampler.GetPercentile(50.f), sampler.GetPercentile(90.f), sampler.GetPercentile(99.f), sampler.GetPercentile(100.f)));
+
+		if (report.bIsRequired)
+		{
+			TestTrue(FString::Printf(TEXT("%s recorded frames"), report.Name), sampler.FrameCostsMs.Num() > 0);
+		}
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDropletMoveDispatchBenchmarkTest, "Droplet.Performance.MoveDispatch", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FDropletMoveDispatchBenchmarkTest::RunTest(const FString& Parameters)
+{
+	// Number of calls timed for each path
+	constexpr int32 CallCount = 100000;
+
+	// Use a state description of our own so no character is driven by the calls
+	UDropletMaterialStateDescription* pMaterialStateDescription = NewObject<UDropletMaterialStateDescription>(GetTransientPackage(), NAME_None, RF_Transient);
+
+	FMoveFunction moveFunction;
+	moveFunction.BindUFunction(pMaterialStateDescription, FName("MoveFunction"));
+
+	if (!TestTrue(TEXT("Move function bound by name"), moveFunction.IsBound()))
+	{
+		return false;
+	}
+
+	// The native call is only taken for the states resolving the move function to the base class one, as in ADropletPlayerCharacter::SetMaterialState
+	const UFunction* pMoveFunction = pMaterialStateDescription->FindFunction(FName("MoveFunction"));
+	TestTrue(TEXT("Base state description is safe for the native dispatch"),
+		pMoveFunction != nullptr && pMoveFunction->GetOwnerClass() == UDropletMaterialStateDescription::StaticClass());
+
+	const FInputActionValue value(FVector2D(0.f, 1.f));
+
+	uint64 uiStartCycles = FPlatformTime::Cycles64();
+	for (int32 i = 0; i < CallCount; ++i)
+	{
+		pMaterialStateDescription->MoveFunction(value);
+	}
+	const double dNativeMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - uiStartCycles);
+
+	uiStartCycles = FPlatformTime::Cycles64();
+	for (int32 i = 0; i < CallCount; ++i)
+	{
+		moveFunction.ExecuteIfBound(value);
+	}
+	const double dReflectedMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - uiStartCycles);
+
+	AddInfo(FString::Printf(TEXT("MoveDispatch %d calls: native %.3f ms (%.1f ns per call), reflected %.3f ms (%.1f ns per call)"),
+		CallCount, dNativeMs, dNativeMs * 1000000.0 / CallCount, dReflectedMs, dReflectedMs * 1000000.0 / CallCount));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,417 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Player/DropletReplayRecorder.h"
+
+#include "Async/Async.h"
+#include "Misc/FileHelper.h"
+
+
+namespace DropletReplay
+{
+	// Magic and version at the start of a replay file
+	static constexpr uint32 FileMagic = 0x4C505244; // "DRPL"
+	static constexpr uint8 FileVersion = 2;
+
+	// Bits of the keyframe state byte, the MaterialState is in the low bits
+	static constexpr uint8 KeyframeSplashingBit = 1 << 6;
+	static constexpr uint8 KeyframeSlideDashingBit = 1 << 7;
+	static constexpr uint8 KeyframeMaterialStateMask = KeyframeSplashingBit - 1;
+
+	// Quantization steps of the recorded values
+	static constexpr float DeltaTimeScale = 100000.f;	// 10 microseconds
+	static constexpr float MoveValueScale = 1000.f;
+	static constexpr float LocationScale = 10.f;		// millimeters
+	static constexpr float VelocityScale = 10.f;
+	static constexpr float YawScale = 100.f;
+
+	static int32 Quantize(double dValue, float fScale) { return static_cast<int32>(FMath::RoundToDouble(dValue * fScale)); }
+	static double Dequantize(int32 iValue, float fScale) { return static_cast<double>(iValue) / fScale; }
+
+	// Writes an unsigned integer 7 bits per byte, small values take a single byte
+	static void WriteVarUInt(TArray<uint8>& data, uint32 uiValue)
+	{
+		while (uiValue >= 0x80)
+		{
+			data.Add(static_cast<uint8>(uiValue | 0x80));
+			uiValue >>= 7;
+		}
+		data.Add(static_cast<uint8>(uiValue));
+	}
+
+	// Writes a signed integer zigzag encoded, so small negative deltas stay small
+	static void WriteVarInt(TArray<uint8>& data, int32 iValue)
+	{
+		WriteVarUInt(data, (static_cast<uint32>(iValue) << 1) ^ static_cast<uint32>(iValue >> 31));
+	}
+
+	static bool ReadVarUInt(const TArray<uint8>& data, int32& iOffset, int32 iEnd, uint32& uiOutValue)
+	{
+		uiOutValue = 0;
+
+		for (int32 iShift = 0; iShift < 35; iShift += 7)
+		{
+			if (iOffset >= iEnd)
+			{
+				return false;
+			}
+
+			const uint8 uiByte = data[iOffset++];
+			uiOutValue |= static_cast<uint32>(uiByte & 0x7F) << iShift;
+
+			if ((uiByte & 0x80) == 0)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	static bool ReadVarInt(const TArray<uint8>& data, int32& iOffset, int32 iEnd, int32& iOutValue)
+	{
+		uint32 uiValue;
+		if (!ReadVarUInt(data, iOffset, iEnd, uiValue))
+		{
+			return false;
+		}
+
+		iOutValue = static_cast<int32>(uiValue >> 1) ^ -static_cast<int32>(uiValue & 1);
+		return true;
+	}
+
+	// Writes the delta of a quantized value against its previous value
+	static void WriteDelta(TArray<uint8>& data, double dValue, double dPreviousValue, float fScale)
+	{
+		WriteVarInt(data, Quantize(dValue, fScale) - Quantize(dPreviousValue, fScale));
+	}
+
+	static bool ReadDelta(const TArray<uint8>& data, int32& iOffset, int32 iEnd, double dPreviousValue, float fScale, double& dOutValue)
+	{
+		int32 iDelta;
+		if (!ReadVarInt(data, iOffset, iEnd, iDelta))
+		{
+			return false;
+		}
+
+		dOutValue = Dequantize(Quantize(dPreviousValue, fScale) + iDelta, fScale);
+		return true;
+	}
+}
+
+
+// ---------------------------------------------------------- Recorder -------------------------------------------------------------
+
+void FDropletReplayRecorder::Start(bool bIsRingMode, int32 iMaxChunkBytes, int32 iMaxChunkCount, int32 iKeyframeInterval)
+{
+	m_Chunks.Reset();
+	m_PendingFrame = FDropletReplayFrame();
+	m_PreviousFrame = FDropletReplayFrame();
+
+	m_bIsRingMode = bIsRingMode;
+	m_iMaxChunkBytes = FMath::Max(iMaxChunkBytes, 256);
+	m_iMaxChunkCount = FMath::Max(iMaxChunkCount, 1);
+	m_iKeyframeInterval = FMath::Max(iKeyframeInterval, 1);
+
+	m_Chunks.AddDefaulted_GetRef().Reserve(m_iMaxChunkBytes);
+	m_bIsChunkStart = true;
+	m_iFramesSinceKeyframe = 0;
+	m_bIsRecording = true;
+}
+
+void FDropletReplayRecorder::RecordMove(const FVector2D& vMoveValue)
+{
+	m_PendingFrame.uiFlags |= FDropletReplayFrame::Flag_Move;
+	m_PendingFrame.vMoveValue = vMoveValue;
+}
+
+void FDropletReplayRecorder::RecordMaterialState(EDropletMaterialState eMaterialState)
+{
+	m_PendingFrame.uiFlags |= FDropletReplayFrame::Flag_MaterialState;
+	m_PendingFrame.eMaterialState = eMaterialState;
+}
+
+void FDropletReplayRecorder::EndFrame(float fDeltaTime, const FVector& vLocation, const FVector& vVelocity, float fYaw, EDropletMaterialState eMaterialState, bool bIsSplashing, bool bIsSlideDashing)
+{
+	using namespace DropletReplay;
+
+	if (!m_bIsRecording)
+	{
+		return;
+	}
+
+	FDropletReplayFrame& frame = m_PendingFrame;
+	frame.fDeltaTime = fDeltaTime;
+
+	//If the frame starts a chunk, encode it against zero so the chunk decodes on its own
+	if (m_bIsChunkStart)
+	{
+		m_PreviousFrame = FDropletReplayFrame();
+	}
+
+	//If a keyframe is due, add the transform and velocity to the frame
+	if (m_bIsChunkStart || ++m_iFramesSinceKeyframe >= m_iKeyframeInterval)
+	{
+		frame.uiFlags |= FDropletReplayFrame::Flag_Keyframe;
+		frame.vLocation = vLocation;
+		frame.vVelocity = vVelocity;
+		frame.fYaw = fYaw;
+		frame.eMaterialState = eMaterialState;
+		frame.bIsSplashing = bIsSplashing;
+		frame.bIsSlideDashing = bIsSlideDashing;
+		m_iFramesSinceKeyframe = 0;
+	}
+
+	m_bIsChunkStart = false;
+
+	TArray<uint8>& chunk = m_Chunks.Last();
+
+	chunk.Add(frame.uiFlags);
+	WriteVarUInt(chunk, static_cast<uint32>(FMath::Max(Quantize(frame.fDeltaTime, DeltaTimeScale), 0)));
+
+	if (frame.HasFlag(FDropletReplayFrame::Flag_Move))
+	{
+		WriteDelta(chunk, frame.vMoveValue.X, m_PreviousFrame.vMoveValue.X, MoveValueScale);
+		WriteDelta(chunk, frame.vMoveValue.Y, m_PreviousFrame.vMoveValue.Y, MoveValueScale);
+		m_PreviousFrame.vMoveValue = frame.vMoveValue;
+	}
+
+	// A keyframe writes the current MaterialState in its state byte, which also covers a transition of the frame
+	if (frame.HasFlag(FDropletReplayFrame::Flag_MaterialState) && !frame.HasFlag(FDropletReplayFrame::Flag_Keyframe))
+	{
+		chunk.Add(static_cast<uint8>(frame.eMaterialState));
+	}
+
+	if (frame.HasFlag(FDropletReplayFrame::Flag_Keyframe))
+	{
+		chunk.Add((static_cast<uint8>(frame.eMaterialState) & KeyframeMaterialStateMask) |
+			(frame.bIsSplashing ? KeyframeSplashingBit : 0) | (frame.bIsSlideDashing ? KeyframeSlideDashingBit : 0));
+
+		for (int32 i = 0; i < 3; ++i)
+		{
+			WriteDelta(chunk, frame.vLocation[i], m_PreviousFrame.vLocation[i], LocationScale);
+		}
+		for (int32 i = 0; i < 3; ++i)
+		{
+			WriteDelta(chunk, frame.vVelocity[i], m_PreviousFrame.vVelocity[i], VelocityScale);
+		}
+		WriteDelta(chunk, frame.fYaw, m_PreviousFrame.fYaw, YawScale);
+
+		m_PreviousFrame.vLocation = frame.vLocation;
+		m_PreviousFrame.vVelocity = frame.vVelocity;
+		m_PreviousFrame.fYaw = frame.fYaw;
+	}
+
+	m_PendingFrame = FDropletReplayFrame();
+
+	//If the chunk is full, start the next one
+	if (chunk.Num() >= m_iMaxChunkBytes)
+	{
+		StartNewChunk();
+	}
+}
+
+void FDropletReplayRecorder::StartNewChunk()
+{
+	//If every chunk is used, drop the oldest one in ring mode, else stop recording
+	if (m_Chunks.Num() >= m_iMaxChunkCount)
+	{
+		if (!m_bIsRingMode)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FDropletReplayRecorder::StartNewChunk: the replay is full (%d bytes), recording stopped"), GetRecordedBytes());
+			m_bIsRecording = false;
+			return;
+		}
+
+		// Reuse the oldest chunk's allocation for the new one
+		TArray<uint8> oldestChunk = MoveTemp(m_Chunks[0]);
+		m_Chunks.RemoveAt(0);
+		oldestChunk.Reset();
+		m_Chunks.Add(MoveTemp(oldestChunk));
+	}
+	else
+	{
+		m_Chunks.AddDefaulted_GetRef().Reserve(m_iMaxChunkBytes);
+	}
+
+	m_bIsChunkStart = true;
+}
+
+int32 FDropletReplayRecorder::GetRecordedBytes() const
+{
+	int32 iBytes = 0;
+	for (const TArray<uint8>& chunk : m_Chunks)
+	{
+		iBytes += chunk.Num();
+	}
+	return iBytes;
+}
+
+void FDropletReplayRecorder::SaveToFileAsync(const FString& filePath) const
+{
+	using namespace DropletReplay;
+
+	// Header then every chunk prefixed with its size
+	TArray<uint8> fileData;
+	fileData.Reserve(GetRecordedBytes() + 8 + m_Chunks.Num() * 4);
+	fileData.Append(reinterpret_cast<const uint8*>(&FileMagic), sizeof(FileMagic));
+	fileData.Add(FileVersion);
+
+	for (const TArray<uint8>& chunk : m_Chunks)
+	{
+		if (chunk.Num() > 0)
+		{
+			WriteVarUInt(fileData, static_cast<uint32>(chunk.Num()));
+			fileData.Append(chunk);
+		}
+	}
+
+	// Writing to disk may take several frames, do it on a worker thread with its own copy of the stream
+	Async(EAsyncExecution::ThreadPool, [fileData = MoveTemp(fileData), filePath]()
+	{
+		if (FFileHelper::SaveArrayToFile(fileData, *filePath))
+		{
+			UE_LOG(LogTemp, Log, TEXT("FDropletReplayRecorder::SaveToFileAsync: saved %d bytes to %s"), fileData.Num(), *filePath);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("FDropletReplayRecorder::SaveToFileAsync: failed to save %s"), *filePath);
+		}
+	});
+}
+
+
+// ----------------------------------------------------------- Player --------------------------------------------------------------
+
+bool FDropletReplayPlayer::LoadFromFile(const FString& filePath)
+{
+	using namespace DropletReplay;
+
+	m_Data.Reset();
+	m_iOffset = 0;
+	m_iChunkEnd = 0;
+
+	if (!FFileHelper::LoadFileToArray(m_Data, *filePath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("FDropletReplayPlayer::LoadFromFile: failed to load %s"), *filePath);
+		return false;
+	}
+
+	uint32 uiMagic = 0;
+	if (m_Data.Num() < static_cast<int32>(sizeof(uiMagic)) + 1)
+	{
+		UE_LOG(LogTemp, Error, TEXT("FDropletReplayPlayer::LoadFromFile: %s is not a droplet replay"), *filePath);
+		return false;
+	}
+
+	FMemory::Memcpy(&uiMagic, m_Data.GetData(), sizeof(uiMagic));
+	if (uiMagic != FileMagic || m_Data[sizeof(uiMagic)] != FileVersion)
+	{
+		UE_LOG(LogTemp, Error, TEXT("FDropletReplayPlayer::LoadFromFile: %s is not a droplet replay of version %d"), *filePath, FileVersion);
+		return false;
+	}
+
+	m_iOffset = sizeof(uiMagic) + 1;
+	m_iChunkEnd = m_iOffset;
+	return true;
+}
+
+bool FDropletReplayPlayer::StartNextChunk()
+{
+	using namespace DropletReplay;
+
+	uint32 uiChunkSize;
+	if (!ReadVarUInt(m_Data, m_iOffset, m_Data.Num(), uiChunkSize) || static_cast<int64>(m_iOffset) + uiChunkSize > m_Data.Num())
+	{
+		return false;
+	}
+
+	m_iChunkEnd = m_iOffset + static_cast<int32>(uiChunkSize);
+
+	// Every chunk is encoded against zero
+	m_PreviousFrame = FDropletReplayFrame();
+	return true;
+}
+
+bool FDropletReplayPlayer::ReadNextFrame(FDropletReplayFrame& outFrame)
+{
+	using namespace DropletReplay;
+
+	//If the chunk is over, move to the next one which isn't empty
+	while (m_iOffset >= m_iChunkEnd)
+	{
+		if (!StartNextChunk())
+		{
+			return false;
+		}
+	}
+
+	outFrame = FDropletReplayFrame();
+	outFrame.uiFlags = m_Data[m_iOffset++];
+
+	uint32 uiDeltaTime;
+	if (!ReadVarUInt(m_Data, m_iOffset, m_iChunkEnd, uiDeltaTime))
+	{
+		return false;
+	}
+	outFrame.fDeltaTime = static_cast<float>(Dequantize(static_cast<int32>(uiDeltaTime), DeltaTimeScale));
+
+	if (outFrame.HasFlag(FDropletReplayFrame::Flag_Move))
+	{
+		if (!ReadDelta(m_Data, m_iOffset, m_iChunkEnd, m_PreviousFrame.vMoveValue.X, MoveValueScale, outFrame.vMoveValue.X) ||
+			!ReadDelta(m_Data, m_iOffset, m_iChunkEnd, m_PreviousFrame.vMoveValue.Y, MoveValueScale, outFrame.vMoveValue.Y))
+		{
+			return false;
+		}
+		m_PreviousFrame.vMoveValue = outFrame.vMoveValue;
+	}
+
+	if (outFrame.HasFlag(FDropletReplayFrame::Flag_MaterialState) && !outFrame.HasFlag(FDropletReplayFrame::Flag_Keyframe))
+	{
+		if (m_iOffset >= m_iChunkEnd)
+		{
+			return false;
+		}
+		outFrame.eMaterialState = static_cast<EDropletMaterialState>(m_Data[m_iOffset++]);
+	}
+
+	if (outFrame.HasFlag(FDropletReplayFrame::Flag_Keyframe))
+	{
+		if (m_iOffset >= m_iChunkEnd)
+		{
+			return false;
+		}
+
+		const uint8 uiKeyframeState = m_Data[m_iOffset++];
+		outFrame.eMaterialState = static_cast<EDropletMaterialState>(uiKeyframeState & KeyframeMaterialStateMask);
+		outFrame.bIsSplashing = (uiKeyframeState & KeyframeSplashingBit) != 0;
+		outFrame.bIsSlideDashing = (uiKeyframeState & KeyframeSlideDashingBit) != 0;
+
+		double dYaw;
+		for (int32 i = 0; i < 3; ++i)
+		{
+			if (!ReadDelta(m_Data, m_iOffset, m_iChunkEnd, m_PreviousFrame.vLocation[i], LocationScale, outFrame.vLocation[i]))
+			{
+				return false;
+			}
+		}
+		for (int32 i = 0; i < 3; ++i)
+		{
+			if (!ReadDelta(m_Data, m_iOffset, m_iChunkEnd, m_PreviousFrame.vVelocity[i], VelocityScale, outFrame.vVelocity[i]))
+			{
+				return false;
+			}
+		}
+		if (!ReadDelta(m_Data, m_iOffset, m_iChunkEnd, m_PreviousFrame.fYaw, YawScale, dYaw))
+		{
+			return false;
+		}
+		outFrame.fYaw = static_cast<float>(dYaw);
+
+		m_PreviousFrame.vLocation = outFrame.vLocation;
+		m_PreviousFrame.vVelocity = outFrame.vVelocity;
+		m_PreviousFrame.fYaw = outFrame.fYaw;
+	}
+
+	return true;
+}
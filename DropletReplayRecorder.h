@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "MaterialStateDescription/DropletMaterialStateDescription.h"
+
+
+/**
+ * One frame of a droplet replay: the input sent to the character during the frame,
+ * its material state transition and, every few frames, a keyframe of its transform and velocity
+ */
+struct FDropletReplayFrame
+{
+	// Flags of the events of the frame
+	enum EFlags : uint8
+	{
+		Flag_Move = 1 << 0,
+		Flag_Jump = 1 << 1,
+		Flag_ChangeMaterialStatePositive = 1 << 2,
+		Flag_ChangeMaterialStateNegative = 1 << 3,
+		Flag_Interact = 1 << 4,
+		Flag_MaterialState = 1 << 5,
+		Flag_Keyframe = 1 << 6,
+		Flag_StopJumping = 1 << 7,
+	};
+
+	uint8 uiFlags = 0;
+	// Frame delta time in seconds
+	float fDeltaTime = 0.f;
+	// Last move input value of the frame
+	FVector2D vMoveValue = FVector2D::ZeroVector;
+	// MaterialState entered during the frame, or the current one on keyframes
+	EDropletMaterialState eMaterialState = EDropletMaterialState::EDropletMaterialState_None;
+	// Keyframe values
+	FVector vLocation = FVector::ZeroVector;
+	FVector vVelocity = FVector::ZeroVector;
+	float fYaw = 0.f;
+	bool bIsSplashing = false;
+	bool bIsSlideDashing = false;
+
+	bool HasFlag(EFlags eFlag) const { return (uiFlags & eFlag) != 0; }
+};
+
+
+/**
+ * Records droplet replay frames into a compact binary stream:
+ * values are quantized, delta encoded against the previous frames and written as variable length integers.
+ * The stream is split in chunks which each start with an absolute keyframe, so the oldest chunk can be
+ * dropped in ring mode and the memory stays bounded.
+ */
+class FDropletReplayRecorder
+{
+public:
+	/** Called to start recording, dropping what was recorded before */
+	void Start(bool bIsRingMode, int32 iMaxChunkBytes, int32 iMaxChunkCount, int32 iKeyframeInterval);
+
+	/** Called to stop recording */
+	void Stop() { m_bIsRecording = false; }
+
+	/** Returns true while recording */
+	bool IsRecording() const { return m_bIsRecording; }
+
+	/** Called to record the input of the frame being recorded */
+	void RecordMove(const FVector2D& vMoveValue);
+	void RecordJump() { m_PendingFrame.uiFlags |= FDropletReplayFrame::Flag_Jump; }
+	void RecordStopJumping() { m_PendingFrame.uiFlags |= FDropletReplayFrame::Flag_StopJumping; }
+	void RecordChangeMaterialState(bool bIsPositive) { m_PendingFrame.uiFlags |= bIsPositive ? FDropletReplayFrame::Flag_ChangeMaterialStatePositive : FDropletReplayFrame::Flag_ChangeMaterialStateNegative; }
+	void RecordInteract() { m_PendingFrame.uiFlags |= FDropletReplayFrame::Flag_Interact; }
+	void RecordMaterialState(EDropletMaterialState eMaterialState);
+
+	/**
+	 * Called at the end of a frame to encode it with the character's transform, velocity, MaterialState and splash and slide dash flags,
+	 * which are written on the keyframes so a replay starting at any chunk can restore them
+	 */
+	void EndFrame(float fDeltaTime, const FVector& vLocation, const FVector& vVelocity, float fYaw, EDropletMaterialState eMaterialState, bool bIsSplashing, bool bIsSlideDashing);
+
+	/** Returns the size of the recorded chunks in bytes */
+	int32 GetRecordedBytes() const;
+
+	/** Called to write the recorded stream to a file on a background thread */
+	void SaveToFileAsync(const FString& filePath) const;
+
+private:
+	/** Called to close the current chunk and start a new one, dropping the oldest chunk or stopping when full */
+	void StartNewChunk();
+
+	// Recorded chunks, the last one is being written
+	TArray<TArray<uint8>> m_Chunks;
+	// Frame being recorded
+	FDropletReplayFrame m_PendingFrame;
+	// Previous encoded frame, the base of the delta encoding
+	FDropletReplayFrame m_PreviousFrame;
+
+	bool m_bIsRecording = false;
+	bool m_bIsRingMode = false;
+	int32 m_iMaxChunkBytes = 64 * 1024;
+	int32 m_iMaxChunkCount = 64;
+	int32 m_iKeyframeInterval = 30;
+	// Frames encoded since the last keyframe
+	int32 m_iFramesSinceKeyframe = 0;
+	// Whether the next frame starts a chunk and must be an absolute keyframe
+	bool m_bIsChunkStart = true;
+};
+
+
+/**
+ * Decodes a droplet replay stream recorded by FDropletReplayRecorder, one frame at a time
+ */
+class FDropletReplayPlayer
+{
+public:
+	/** Called to load a replay file, returns false if it is not a droplet replay */
+	bool LoadFromFile(const FString& filePath);
+
+	/** Called to decode the next frame, returns false once the replay is over */
+	bool ReadNextFrame(FDropletReplayFrame& outFrame);
+
+private:
+	/** Called to move to the next chunk, returns false if there is none */
+	bool StartNextChunk();
+
+	// Whole replay file
+	TArray<uint8> m_Data;
+	// Read offset in the replay file
+	int32 m_iOffset = 0;
+	// End of the current chunk in the replay file
+	int32 m_iChunkEnd = 0;
+	// Previous decoded frame, the base of the delta decoding
+	FDropletReplayFrame m_PreviousFrame;
+};